@@ -2,61 +2,11 @@
 #include <amath.h>
 #include <armpl.h>
 #include <cstdint>
+#include <iomanip>
 #include <omp.h>
-#include <sys/time.h>
 #include <vector>
 #include <arm_sve.h>
-
-#define ui64 uint64_t
-
-/*******************************************
- * @brief Returns the current time in microseconds.
- *
- * Used for performance measurement.
- * @return Current time in microseconds.
- *******************************************/
-static double dml_micros(){
-    struct timeval tv; 
-    gettimeofday(&tv, nullptr);
-    return double(tv.tv_sec) * 1e6 + tv.tv_usec;
-}
-
-/*******************************************
- * @brief XORSHIFT128+ pseudo-random number generator state.
- *
- * Holds the state for the RNG.
- *******************************************/
-struct xorshift128plus_state {
-    ui64 s[2]; // Internal state of the generator.
-};
-
-/*******************************************
- * @brief Initializes the XORSHIFT128+ RNG state.
- *
- * @param st The state to initialize.
- * @param seed The seed value for initialization.
- *******************************************/
-static inline void xorshift128plus_init(xorshift128plus_state &st, ui64 seed){
-    st.s[0] = seed;
-    st.s[1] = seed ^ 0x9E3779B97F4A7C15ULL; // Combines seed with a constant.
-}
-
-/*******************************************
- * @brief Generates a random 64-bit unsigned integer.
- *
- * @param st The state of the RNG.
- * @return A 64-bit random number.
- *******************************************/
-static inline ui64 xorshift128plus(xorshift128plus_state &st){
-    ui64 x = st.s[0];
-    ui64 y = st.s[1];
-    st.s[0] = y;
-    x ^= x << 23;
-    x ^= x >> 17;
-    x ^= y ^ (y >> 26);
-    st.s[1] = x;
-    return x + y;
-}
+#include "BSM_kernels.h"
 
 /*******************************************
  * @brief Generates two Gaussian random variables using the Box-Muller transform.
@@ -75,53 +25,6 @@ static inline void box_muller_2(double u1, double u2, double &g1, double &g2){
     g2 = r * std::sin(theta);
 }
 
-/*******************************************
- * @brief Approximates the exponential function using SVE intrinsics.
- *
- * The approximation uses a truncated Taylor series.
- * @param x Input vector of values.
- * @return Approximated exponential values for the input vector.
- *******************************************/
-static inline svfloat64_t sve_exp_approx(svfloat64_t x)
-{
-    svbool_t pg = svptrue_b64(); // Active predicate for all lanes.
-    svfloat64_t mn = svdup_f64(-10.0); // Minimum clamp value.
-    svfloat64_t mx = svdup_f64(10.0);  // Maximum clamp value.
-    x = svmax_f64_m(pg, x, mn); // Clamp to minimum.
-    x = svmin_f64_m(pg, x, mx); // Clamp to maximum.
-
-    // Polynomial approximation: e^x ~ 1 + x + x^2/2 + x^3/6
-    svfloat64_t one = svdup_f64(1.0);
-    svfloat64_t x2 = svmul_f64_m(pg, x, x); // x^2
-    svfloat64_t x3 = svmul_f64_m(pg, x2, x); // x^3
-
-    svfloat64_t c2 = svmul_f64_m(pg, x2, svdup_f64(0.5));
-    svfloat64_t c3 = svmul_f64_m(pg, x3, svdup_f64(1.0 / 6.0));
-
-    svfloat64_t s = svadd_f64_m(pg, one, x);
-    s = svadd_f64_m(pg, s, c2);
-    s = svadd_f64_m(pg, s, c3);
-    return s;
-}
-
-/*******************************************
- * @brief Calculates the payoff for a European call option.
- *
- * The payoff is max(ST - K, 0).
- * @param st Vector of terminal stock prices.
- * @param K Strike price.
- * @param pg Predicate for active lanes.
- * @return Vector of payoffs.
- *******************************************/
-static inline svfloat64_t sve_payoff(
-    svfloat64_t st, svfloat64_t K, svbool_t pg)
-{
-    svfloat64_t diff = svsub_f64_m(pg, st, K); // ST - K
-    svbool_t mpos = svcmpgt_f64(pg, diff, svdup_f64(0.0)); // diff > 0
-    svfloat64_t pay = svsel_f64(mpos, diff, svdup_f64(0.0)); // Select positive values.
-    return pay;
-}
-
 /*******************************************
  * @brief Monte Carlo kernel for Black-Scholes pricing using SVE.
  *
@@ -141,7 +44,7 @@ double black_scholes_monte_carlo_svechunk(
     double vol = sigma * std::sqrt(T);
     double disc = std::exp(-r * T);
 
-    const int CHUNK = 512; // Number of random samples per chunk.
+    constexpr int CHUNK = 512; // Number of random samples per chunk.
     ui64 nBlocks = nSim / CHUNK;
     ui64 reste = nSim % CHUNK;
 
@@ -153,7 +56,8 @@ double black_scholes_monte_carlo_svechunk(
         ui64 seed = 0xFACEBEEF ^ (0x1234ULL * (omp_get_thread_num() + 1));
         xorshift128plus_init(rng, seed);
 
-        std::vector<double> gArr(CHUNK);
+        // Thread-owned, vector-aligned scratch reused by every call.
+        alignas(64) static thread_local double gArr[CHUNK];
 
         for (ui64 b = 0; b < nBlocks; b++) {
             // Generate CHUNK Gaussian samples.
@@ -195,7 +99,7 @@ double black_scholes_monte_carlo_svechunk(
 
         // Handle remainder simulations.
         if(reste>0){
-            std::vector<double> gR(reste);
+            double* gR = gArr; // reste < CHUNK
             for(ui64 i=0; i<reste; i+=2){
                 ui64 ra=xorshift128plus(rng);
                 ui64 rb=xorshift128plus(rng);
@@ -225,6 +129,10 @@ double black_scholes_monte_carlo_svechunk(
                     sumLocal+= tmp[j];
                 }
             }
+            payoffSum += sumLocal;
+        }
+    }
+
     return payoffSum / double(nSim) * disc;
 }
 
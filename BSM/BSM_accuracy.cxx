@@ -0,0 +1,390 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Accuracy regression check of the fast Monte Carlo backends against
+    the closed-form Black-Scholes-Merton price.
+
+    Usage: ./BSM_accuracy [paths_per_point] [--backends exact,final,mpi,sve,asm]
+                          [--z <crit>] [--tol-abs <x>] [--tol-rel <x>] [--verbose]
+
+    The backends run the shipped kernels from BSM_kernels.h, which the
+    programs themselves include:
+        exact  exact_gbm_model + block_payoff_sum (BSM_final --model exact)
+        final  approx_gbm_model + block_payoff_sum (BSM_final, the default)
+        mpi    black_scholes_monte_carlo_unroll_mpi_approx, the whole
+               kernel of BSM_mpi (calls only, its own mt19937 generator,
+               reseeded from the task seed so runs are reproducible)
+        sve    sve_exp_approx / sve_payoff of BSM_SVE
+        asm    sve_exp_asm of BSM_assembly
+    sve and asm only exist on SVE / AArch64 builds; elsewhere they are
+    reported as skipped. Their drivers only differ from BSM_final in the
+    Box-Muller variant (both outputs of each pair), which is exact, so
+    they are fed BSM_final's normal draws. compile.sh builds this program
+    with the same flags as the others, and the kernels are inlined here,
+    so a flag change that breaks them under -Ofast also shows up here.
+
+    Grid: K/S0 in {0.8 .. 1.2}, sigma in {0.1, 0.2, 0.4}, T in {0.25, 1, 2},
+    calls and puts (90 points, S0 = 100, r = 0.06). Paths are simulated in
+    blocks of CHUNK, and standard errors are taken over the block means.
+    exact, final, sve and asm price a point on the same normal draws,
+    which separates the two error terms:
+        noise  exact MC - closed form, z-score on its standard error; a
+               failure here means the generator / sampling is broken
+        bias   mean paired difference backend - exact, with its own
+               (much smaller) standard error; for mpi, which draws its
+               own normals, MC - closed form with the MC standard error
+    A backend fails a point if |bias| > tol + z * se(bias), with
+    tol = max(tol_abs, tol_rel * price). The exact backend fails a point
+    if |noise| > z * se. The exit status is 1 if any selected backend
+    fails, so the program can gate a change to the kernels or the flags.
+*/
+
+#define NB 5
+enum { B_EXACT = 0, B_FINAL = 1, B_MPI = 2, B_SVE = 3, B_ASM = 4 };
+static const char *BACKEND_NAMES[NB] = {"exact", "final", "mpi", "sve", "asm"};
+
+/*******************************************
+ * @brief Whether a backend is compiled into this build.
+ *******************************************/
+static bool backend_built(int b) {
+#if !defined(__ARM_FEATURE_SVE)
+    if (b == B_SVE) return false;
+#endif
+#if !defined(__aarch64__)
+    if (b == B_ASM) return false;
+#endif
+    (void)b;
+    return true;
+}
+
+/*******************************************
+ * @brief One grid point.
+ *******************************************/
+struct grid_point {
+    double K, T, sigma;
+    int isCall;
+    double price;               // closed form
+};
+
+#define CHUNK 256
+#define TASK_PATHS (1 << 16)
+
+#if defined(__aarch64__)
+/*******************************************
+ * @brief Model policy of BSM_assembly: terminal price through sve_exp_asm.
+ *******************************************/
+struct asm_gbm_model {
+    double S0, drift, vol;
+
+    asm_gbm_model(double S0_, double T, double r, double sigma)
+        : S0(S0_), drift((r - 0.5 * sigma * sigma) * T), vol(sigma * std::sqrt(T)) {}
+
+    inline double terminal(double g) const {
+        return S0 * sve_exp_asm(drift + vol * g);
+    }
+};
+#endif
+
+#if defined(__ARM_FEATURE_SVE)
+/*******************************************
+ * @brief Sum of payoffs over one block with the SVE kernel of BSM_SVE.
+ *
+ * Same lane loop as black_scholes_monte_carlo_svechunk; a put is
+ * sve_payoff with the strike and the terminal price swapped.
+ *******************************************/
+static double sve_block_payoff_sum(const grid_point &g, double S0, double r,
+                                   const double *u1, const double *u2, int n) {
+    alignas(64) double gArr[CHUNK];
+    for (int i = 0; i < n; i++) gArr[i] = box_muller_no_reject(u1[i], u2[i]);
+
+    const double drift = (r - 0.5 * g.sigma * g.sigma) * g.T;
+    const double vol = g.sigma * std::sqrt(g.T);
+    int VL = svcntd();
+    double sum = 0.0;
+    for (int i = 0; i < n; i += VL) {
+        svbool_t pg = svwhilelt_b64(i, n);
+        svfloat64_t vg = svld1_f64(pg, &gArr[i]);
+        svfloat64_t x = svmad_f64_m(pg, vg, svdup_f64(vol), svdup_f64(drift));
+        svfloat64_t vst = svmul_f64_m(pg, sve_exp_approx(x), svdup_f64(S0));
+        svfloat64_t pay = g.isCall ? sve_payoff(vst, svdup_f64(g.K), pg)
+                                   : sve_payoff(svdup_f64(g.K), vst, pg);
+        sum += svaddv_f64(pg, pay);
+    }
+    return sum;
+}
+#endif
+
+/*******************************************
+ * @brief Per-task sums over block means.
+ *
+ * s/ss: sums of the discounted block means per backend; d/dd: sums of
+ * (backend - exact) block means, used for the paired bias.
+ *******************************************/
+struct task_sums {
+    double s[NB], ss[NB], d[NB], dd[NB];
+};
+
+/*******************************************
+ * @brief Adds one block mean of a backend to the task sums.
+ *******************************************/
+static inline void add_block(task_sums &t, int b, double v, double exact) {
+    t.s[b] += v;
+    t.ss[b] += v * v;
+    t.d[b] += v - exact;
+    t.dd[b] += (v - exact) * (v - exact);
+}
+
+/*******************************************
+ * @brief Simulates TASK_PATHS paths of one point for the selected backends.
+ *
+ * @tparam Payoff Payoff policy.
+ * @param g Grid point.
+ * @param S0 Spot.
+ * @param r Rate.
+ * @param use Selected backends.
+ * @param seed Generator seed of this task.
+ * @return Sums over the task.
+ *******************************************/
+template <class Payoff>
+static task_sums simulate_task(const grid_point &g, double S0, double r,
+                               const bool *use, ui64 seed) {
+    const exact_gbm_model exact(S0, g.T, r, g.sigma);
+    const approx_gbm_model approx(S0, g.T, r, g.sigma);
+#if defined(__aarch64__)
+    const asm_gbm_model viaAsm(S0, g.T, r, g.sigma);
+#endif
+    const double scale = std::exp(-r * g.T) / CHUNK;
+
+    xorshift_uniform_rng rng;
+    rng.seed(seed);
+    alignas(64) double u1[CHUNK], u2[CHUNK];
+    task_sums t = {};
+
+    for (int done = 0; done < TASK_PATHS; done += CHUNK) {
+        for (int i = 0; i < CHUNK; i++) {
+            u1[i] = rng.next();
+            u2[i] = rng.next();
+        }
+        double pe = scale * block_payoff_sum<Payoff>(exact, g.K, u1, u2, CHUNK);
+        add_block(t, B_EXACT, pe, pe);
+        if (use[B_FINAL])
+            add_block(t, B_FINAL, scale * block_payoff_sum<Payoff>(approx, g.K, u1, u2, CHUNK), pe);
+#if defined(__ARM_FEATURE_SVE)
+        if (use[B_SVE])
+            add_block(t, B_SVE, scale * sve_block_payoff_sum(g, S0, r, u1, u2, CHUNK), pe);
+#endif
+#if defined(__aarch64__)
+        if (use[B_ASM])
+            add_block(t, B_ASM, scale * block_payoff_sum<Payoff>(viaAsm, g.K, u1, u2, CHUNK), pe);
+#endif
+        // BSM_mpi returns the discounted payoff sum and only prices calls.
+        if (use[B_MPI] && g.isCall) {
+            if (done == 0) gaussian_box_muller_seed(seed_mix(seed ^ 0x6D7069ULL));
+            double pm = black_scholes_monte_carlo_unroll_mpi_approx(
+                ui64(std::llround(S0)), ui64(std::llround(g.K)), g.T, r, g.sigma, 0.0, CHUNK) / CHUNK;
+            add_block(t, B_MPI, pm, pe);
+        }
+    }
+    return t;
+}
+
+/*******************************************
+ * @brief Mean and standard error from a sum and a sum of squares.
+ *******************************************/
+static void mean_se(double s, double ss, double n, double &mean, double &se) {
+    mean = s / n;
+    double var = std::max(ss / n - mean * mean, 0.0) * n / (n - 1.0);
+    se = std::sqrt(var / n);
+}
+
+/*******************************************
+ * @brief Result of one backend at one point.
+ *******************************************/
+struct point_result {
+    double mc, se;              // backend price and its standard error
+    double z;                   // (mc - closed form) / se
+    double bias, seBias;        // difference to exact (mpi: to closed form)
+    bool priced;                // false for puts on the mpi backend
+    bool fail;
+};
+
+/*******************************************
+ * @brief Main function: runs the grid, reports, sets the exit status.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return 0 if every selected backend passes, 1 otherwise.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    ui64 paths = 1ULL << 22;
+    bool use[NB] = {true, true, true, true, true};
+    double zCrit = 4.0, tolAbs = 2e-3, tolRel = 5e-3;
+    bool verbose = false;
+    for (int a = 1; a < argc; a++) {
+        std::string opt = argv[a];
+        if (opt == "--backends" && a + 1 < argc) {
+            std::fill(use, use + NB, false);
+            std::stringstream ss(argv[++a]);
+            std::string name;
+            while (std::getline(ss, name, ',')) {
+                int b = int(std::find(BACKEND_NAMES, BACKEND_NAMES + NB, name) - BACKEND_NAMES);
+                if (b == NB) { std::cerr << "unknown backend: " << name << "\n"; return 2; }
+                use[b] = true;
+            }
+        }
+        else if (opt == "--z" && a + 1 < argc) zCrit = std::atof(argv[++a]);
+        else if (opt == "--tol-abs" && a + 1 < argc) tolAbs = std::atof(argv[++a]);
+        else if (opt == "--tol-rel" && a + 1 < argc) tolRel = std::atof(argv[++a]);
+        else if (opt == "--verbose") verbose = true;
+        else if (opt[0] != '-') paths = std::stoull(opt);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [paths_per_point] [--backends exact,final,mpi,sve,asm]"
+                      << " [--z <crit>] [--tol-abs <x>] [--tol-rel <x>] [--verbose]\n";
+            return 2;
+        }
+    }
+    const ui64 nTask = std::max<ui64>(1, (paths + TASK_PATHS - 1) / TASK_PATHS);
+    paths = nTask * TASK_PATHS;
+    const double nBlocks = double(paths / CHUNK);
+    bool skipped[NB] = {};
+    for (int b = 0; b < NB; b++) {
+        skipped[b] = use[b] && !backend_built(b);
+        use[b] = use[b] && !skipped[b];
+    }
+
+    const double S0 = 100.0, r = 0.06;
+    const double moneyness[] = {0.8, 0.9, 1.0, 1.1, 1.2};
+    const double sigmas[] = {0.1, 0.2, 0.4};
+    const double maturities[] = {0.25, 1.0, 2.0};
+    std::vector<grid_point> grid;
+    for (int isCall = 1; isCall >= 0; isCall--)
+        for (double T : maturities)
+            for (double s : sigmas)
+                for (double m : moneyness)
+                    grid.push_back({m * S0, T, s, isCall, bsm_price(S0, m * S0, T, r, 0.0, s, isCall)});
+    const size_t nP = grid.size();
+
+    std::cout << "points= " << nP << "   paths/point= " << paths << "   z= " << zCrit
+              << "   tol= max(" << tolAbs << ", " << tolRel << " * price)"
+              << "   threads= " << omp_get_max_threads() << std::endl;
+
+    double t1 = dml_micros();
+    std::vector<task_sums> sums(nP * nTask);
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (ui64 k = 0; k < nP * nTask; k++) {
+        const grid_point &g = grid[k / nTask];
+        ui64 seed = seed_mix(0xDEADBEEF ^ (0x9E37ULL * (k + 1)));
+        sums[k] = g.isCall ? simulate_task<call_payoff>(g, S0, r, use, seed)
+                           : simulate_task<put_payoff>(g, S0, r, use, seed);
+    }
+
+    std::vector<point_result> res(nP * NB);
+    for (size_t p = 0; p < nP; p++) {
+        task_sums t = {};
+        for (ui64 k = 0; k < nTask; k++) {
+            const task_sums &u = sums[p * nTask + k];
+            for (int b = 0; b < NB; b++) {
+                t.s[b] += u.s[b]; t.ss[b] += u.ss[b];
+                t.d[b] += u.d[b]; t.dd[b] += u.dd[b];
+            }
+        }
+        const double price = grid[p].price, tol = std::max(tolAbs, tolRel * price);
+        for (int b = 0; b < NB; b++) {
+            point_result &o = res[p * NB + b];
+            o = point_result{};
+            o.priced = (use[b] || b == B_EXACT) && (b != B_MPI || grid[p].isCall);
+            if (!o.priced) continue;
+            mean_se(t.s[b], t.ss[b], nBlocks, o.mc, o.se);
+            o.z = (o.se > 0.0) ? (o.mc - price) / o.se : 0.0;
+            if (b == B_EXACT) {
+                o.fail = std::fabs(o.z) > zCrit;
+            } else {
+                if (b == B_MPI) {
+                    o.bias = o.mc - price;
+                    o.seBias = o.se;
+                } else {
+                    mean_se(t.d[b], t.dd[b], nBlocks, o.bias, o.seBias);
+                }
+                o.fail = std::fabs(o.bias) > tol + zCrit * o.seBias;
+            }
+        }
+    }
+    double t2 = dml_micros();
+
+    auto describe = [&](size_t p) {
+        std::ostringstream s;
+        s << (grid[p].isCall ? "call" : "put ") << " K=" << std::setw(3) << grid[p].K
+          << " T=" << std::setw(4) << grid[p].T << " sigma=" << std::setw(3) << grid[p].sigma;
+        return s.str();
+    };
+
+    bool anyFail = false;
+    std::cout << "\nbackend   failed    max|z|   worst bias (+- se)            worst point\n";
+    for (int b = 0; b < NB; b++) {
+        if (skipped[b])
+            std::cout << std::left << std::setw(8) << BACKEND_NAMES[b] << std::right
+                      << "skipped (not built for " << (b == B_SVE ? "SVE" : "AArch64") << ")\n";
+        if (!use[b]) continue;
+        int fails = 0, priced = 0;
+        double maxZ = 0.0;
+        size_t worst = 0;
+        for (size_t p = 0; p < nP; p++) {
+            const point_result &o = res[p * NB + b];
+            if (!o.priced) continue;
+            priced++;
+            fails += o.fail;
+            maxZ = std::max(maxZ, std::fabs(o.z));
+            double key = (b == B_EXACT) ? std::fabs(o.z) : std::fabs(o.bias);
+            double cur = (b == B_EXACT) ? std::fabs(res[worst * NB + b].z) : std::fabs(res[worst * NB + b].bias);
+            if (key > cur) worst = p;
+        }
+        const point_result &w = res[worst * NB + b];
+        anyFail |= fails > 0;
+        std::cout << std::left << std::setw(8) << BACKEND_NAMES[b] << std::right
+                  << std::setw(4) << fails << "/" << std::left << std::setw(4) << priced << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(9) << maxZ
+                  << std::scientific << std::setprecision(2) << std::setw(12) << w.bias
+                  << " (" << w.seBias << ")   " << std::defaultfloat << describe(worst)
+                  << (fails ? "   FAIL" : "   ok") << "\n";
+    }
+
+    std::cout << "\n" << (verbose ? "all points" : "failed points") << ":\n"
+              << "backend  point                                closed     mc          se"
+              << "        z     bias        se(bias)\n";
+    for (int b = 0; b < NB; b++) {
+        if (!use[b]) continue;
+        for (size_t p = 0; p < nP; p++) {
+            const point_result &o = res[p * NB + b];
+            if (!o.priced || (!verbose && !o.fail)) continue;
+            std::cout << std::left << std::setw(8) << BACKEND_NAMES[b] << " " << std::setw(36)
+                      << describe(p) << std::right << std::fixed << std::setprecision(5)
+                      << std::setw(9) << grid[p].price << std::setw(11) << o.mc
+                      << std::scientific << std::setprecision(2) << std::setw(11) << o.se
+                      << std::fixed << std::setw(9) << o.z
+                      << std::scientific << std::setw(11) << o.bias << std::setw(11) << o.seBias
+                      << (o.fail ? "  FAIL" : "") << "\n";
+        }
+    }
+
+    // Exact-backend price of the 1y K=110 call, as printed by the other programs.
+    double value = 0.0;
+    for (size_t p = 0; p < nP; p++)
+        if (grid[p].isCall && std::fabs(grid[p].K - 110.0) < 1e-9 && grid[p].T == 1.0 && grid[p].sigma == 0.2)
+            value = res[p * NB + B_EXACT].mc;
+    std::cout << "\n" << (anyFail ? "ACCURACY CHECK FAILED" : "accuracy check passed") << "\n"
+              << std::fixed << std::setprecision(6)
+              << "value= " << value << " in " << (t2 - t1) * 1e-6 << " s\n";
+    return anyFail ? 1 : 0;
+}
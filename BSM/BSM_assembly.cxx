@@ -4,59 +4,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <iomanip>
-#include <sys/time.h>
 #include <omp.h>
-
-#define ui64 uint64_t
-
-/*******************************************
- * @brief Returns the current time in microseconds.
- *
- * Used for performance measurement.
- * @return Current time in microseconds.
- *******************************************/
-static double dml_micros(){
-    struct timeval tv; 
-    gettimeofday(&tv, nullptr);
-    return double(tv.tv_sec) * 1.0e6 + tv.tv_usec;
-}
-
-/*******************************************
- * @brief XORSHIFT128+ RNG state structure.
- *
- * Holds the state for the random number generator.
- *******************************************/
-struct xorshift128plus_state {
-    ui64 s[2]; // Two 64-bit integers for RNG state.
-};
-
-/*******************************************
- * @brief Initializes the XORSHIFT128+ RNG state.
- *
- * @param st The RNG state to initialize.
- * @param seed The seed for random number generation.
- *******************************************/
-static inline void xorshift128plus_init(xorshift128plus_state &st, ui64 seed){
-    st.s[0] = seed;
-    st.s[1] = seed ^ 0x9E3779B97F4A7C15ULL; // XOR with a constant for variation.
-}
-
-/*******************************************
- * @brief Generates a random 64-bit unsigned integer.
- *
- * @param st The RNG state.
- * @return A random 64-bit integer.
- *******************************************/
-static inline ui64 xorshift128plus(xorshift128plus_state &st){
-    ui64 x = st.s[0];
-    ui64 y = st.s[1];
-    st.s[0] = y;
-    x ^= x << 23; // Bitwise XOR and shifts for randomization.
-    x ^= x >> 17;
-    x ^= y ^ (y >> 26);
-    st.s[1] = x;
-    return x + y; // Combines the two numbers for the final random value.
-}
+#include "BSM_kernels.h"
 
 /*******************************************
  * @brief Generates two Gaussian random variables using Box-Muller transform.
@@ -75,33 +24,10 @@ static inline void approx_box_muller_2(double u1, double u2, double &g1, double
     g2 = r * std::sin(theta); // Second Gaussian variable.
 }
 
-/*******************************************
- * @brief Approximates the exponential function using inline assembly.
- *
- * Implements the approximation e^x ≈ 1 + x + x^2/2 + x^3/6.
- * @param x The input value.
- * @return Approximated exponential value.
- *******************************************/
-static inline double sve_exp_asm(double x) {
-    double res; // Result variable.
-    asm volatile(
-        " fmov d0, %1        \n" // Move input x into register d0.
-        " fmul d1, d0, d0    \n" // Compute x^2 in d1.
-        " fmul d2, d1, d0    \n" // Compute x^3 in d2.
-        " fadd d3, %2, d0    \n" // d3 = c1 + x.
-        " fmadd d3, d1, %3, d3 \n" // d3 += x^2 * c05.
-        " fmadd d3, d2, %4, d3 \n" // d3 += x^3 * c166.
-        " fmov %0, d3        \n" // Move result from d3 to res.
-        : "=w"(res) // Output operand.
-        : "w"(x), "w"(c1), "w"(c05), "w"(c166) // Input operands.
-        : "d0", "d1", "d2", "d3", "memory", "cc" // Clobbered registers.
-    );
-    return res;
-}
-
 /*******************************************
  * @brief Monte Carlo kernel optimized with inline assembly for SVE.
  *
+ * @tparam Payoff Payoff policy (call_payoff, put_payoff, digital_payoff).
  * @param S0 Initial stock price.
  * @param K Strike price.
  * @param T Time to maturity.
@@ -110,6 +36,7 @@ static inline double sve_exp_asm(double x) {
  * @param nSim Number of simulations.
  * @return Discounted mean payoff.
  *******************************************/
+template <class Payoff>
 double black_scholes_monte_carlo_optimized(
     double S0, double K, double T, double r, double sigma, ui64 nSim) {
     double drift = (r - 0.5 * sigma * sigma) * T;
@@ -162,10 +89,10 @@ double black_scholes_monte_carlo_optimized(
             double ST4 = S0 * e4;
 
             // Calculate payoffs.
-            double p1 = (ST1 > K) ? (ST1 - K) : 0.0;
-            double p2 = (ST2 > K) ? (ST2 - K) : 0.0;
-            double p3 = (ST3 > K) ? (ST3 - K) : 0.0;
-            double p4 = (ST4 > K) ? (ST4 - K) : 0.0;
+            double p1 = Payoff::eval(ST1, K);
+            double p2 = Payoff::eval(ST2, K);
+            double p3 = Payoff::eval(ST3, K);
+            double p4 = Payoff::eval(ST4, K);
 
             // Accumulate the payoffs.
             payoffSum += (p1 + p2 + p3 + p4);
@@ -185,7 +112,7 @@ double black_scholes_monte_carlo_optimized(
             double x = drift + vol * g1;
             double e = sve_exp_asm(x);
             double ST = S0 * e;
-            double pay = (ST > K) ? (ST - K) : 0.0;
+            double pay = Payoff::eval(ST, K);
             payoffSum += pay;
         }
     }
@@ -217,7 +144,7 @@ int main(int argc, char* argv[]) {
     double sumVal = 0.0;
     #pragma omp parallel for reduction(+:sumVal)
     for (ui64 run = 0; run < nRuns; run++) {
-        sumVal += black_scholes_monte_carlo_optimized(S0, K, T, r, sigma, nSim);
+        sumVal += black_scholes_monte_carlo_optimized<call_payoff>(S0, K, T, r, sigma, nSim);
     }
 
     double t2 = dml_micros();
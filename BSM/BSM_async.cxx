@@ -0,0 +1,396 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BSM_kernels.h"
+
+/*
+    Asynchronous pricing engine.
+
+    Usage: ./BSM_async <bulk_jobs> <num_sims> [urgent_jobs] [threads]
+
+    price_async() queues a Monte Carlo pricing and returns a std::future
+    immediately. Jobs are cut into slices of SLICE paths; the engine's
+    worker threads always take the next slice of the most urgent job, so
+    a high-priority quote overtakes a running bulk batch after at most one
+    slice per worker. Passing a std::stop_token cancels the job: pending
+    slices are dropped and the future throws pricing_cancelled.
+
+    Slice s of a job is seeded from (job seed, s) and slices are summed in
+    order, so a result does not depend on the thread count or on what else
+    was queued.
+*/
+
+#define CHUNK 256
+#define SLICE (1 << 16)
+
+/*******************************************
+ * @brief Contract and path count of one pricing.
+ *******************************************/
+struct pricing_params {
+    double S0, K, T, r, sigma;
+    int isCall;
+    ui64 nSim;
+    ui64 seed;
+};
+
+/*******************************************
+ * @brief Discounted price and its standard error.
+ *******************************************/
+struct pricing_result {
+    double price;
+    double stdError;
+};
+
+/*******************************************
+ * @brief Thrown by the future of a cancelled pricing.
+ *******************************************/
+struct pricing_cancelled : std::runtime_error {
+    pricing_cancelled() : std::runtime_error("pricing cancelled") {}
+};
+
+/*******************************************
+ * @brief Prices one slice of a job.
+ *
+ * @param p Job parameters.
+ * @param slice Slice index.
+ * @param sum Output sum of payoffs.
+ * @param sumSq Output sum of squared payoffs.
+ *******************************************/
+static void price_slice(const pricing_params &p, ui64 slice, double &sum, double &sumSq) {
+    alignas(64) double g[CHUNK];
+    const double drift = (p.r - 0.5 * p.sigma * p.sigma) * p.T;
+    const double vol = p.sigma * std::sqrt(p.T);
+    const double w = p.isCall ? 1.0 : -1.0;
+
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0xA5ULL * (p.seed + 1)) ^ (0x9E37ULL * (slice + 1))));
+
+    ui64 first = slice * SLICE;
+    ui64 n = std::min<ui64>(SLICE, p.nSim - first);
+    sum = 0.0;
+    sumSq = 0.0;
+    for (ui64 done = 0; done < n; done += CHUNK) {
+        normal_block(rng, g, CHUNK);
+        int cnt = int(std::min<ui64>(CHUNK, n - done));
+        double s = 0.0, s2 = 0.0;
+        #pragma omp simd reduction(+:s, s2)
+        for (int i = 0; i < cnt; i++) {
+            double ST = p.S0 * std::exp(drift + vol * g[i]);
+            double pay = std::max(w * (ST - p.K), 0.0);
+            s += pay;
+            s2 += pay * pay;
+        }
+        sum += s;
+        sumSq += s2;
+    }
+}
+
+/*******************************************
+ * @brief Priority thread pool pricing jobs slice by slice.
+ *******************************************/
+class pricing_engine {
+public:
+    explicit pricing_engine(int threads) {
+        if (threads < 1) threads = 1;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~pricing_engine() {
+        std::vector<std::shared_ptr<job>> dropped;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stopping = true;
+            for (job *j : ready) {
+                j->cancelled = true;
+                j->queued = false;
+                if (j->claimed == j->done) {
+                    j->finishing = true;
+                    dropped.push_back(j->self);
+                }
+            }
+            ready.clear();
+        }
+        cv.notify_all();
+        for (auto &w : workers) w.join();
+        for (auto &j : dropped) finish(j, true);
+    }
+
+    pricing_engine(const pricing_engine &) = delete;
+    pricing_engine &operator=(const pricing_engine &) = delete;
+
+    /*******************************************
+     * @brief Queues a pricing and returns its future.
+     *
+     * @param p Contract, path count and seed.
+     * @param priority Larger is more urgent; equal priorities run FIFO.
+     * @param stop Cancels the job when requested.
+     * @return Future of the discounted price and standard error.
+     *******************************************/
+    std::future<pricing_result> price_async(const pricing_params &p, int priority = 0,
+                                            std::stop_token stop = {}) {
+        auto j = std::make_shared<job>();
+        j->params = p;
+        j->priority = priority;
+        j->nSlices = (p.nSim + SLICE - 1) / SLICE;
+        j->sliceSum.resize(j->nSlices);
+        j->sliceSumSq.resize(j->nSlices);
+        std::future<pricing_result> fut = j->promise.get_future();
+
+        if (j->nSlices == 0) {
+            j->promise.set_exception(std::make_exception_ptr(
+                std::invalid_argument("num_sims must be positive")));
+            return fut;
+        }
+        {
+            std::lock_guard<std::mutex> lk(m);
+            j->seq = nextSeq++;
+            j->queued = true;
+            j->self = j;
+            ready.insert(j.get());
+        }
+        cv.notify_all();
+
+        // Registered last: if the token is already stopped the callback
+        // runs right here and finds the job queued.
+        if (stop.stop_possible()) {
+            j->onStop = std::make_unique<std::stop_callback<cancel_fn>>(stop, cancel_fn{this, j.get()});
+        }
+        return fut;
+    }
+
+private:
+    struct job;
+
+    struct cancel_fn {
+        pricing_engine *engine;
+        job *j;
+        void operator()() const { engine->cancel(j); }
+    };
+
+    struct job {
+        pricing_params params;
+        int priority;
+        ui64 seq;
+        ui64 nSlices;
+        ui64 claimed = 0;
+        ui64 done = 0;
+        bool queued = false;
+        bool cancelled = false;
+        bool finishing = false;      // set once, by whoever will call finish()
+        std::vector<double> sliceSum, sliceSumSq;
+        std::promise<pricing_result> promise;
+        std::shared_ptr<job> self;   // keeps the job alive until it completes
+        std::unique_ptr<std::stop_callback<cancel_fn>> onStop;
+    };
+
+    struct job_order {
+        bool operator()(const job *a, const job *b) const {
+            if (a->priority != b->priority) return a->priority > b->priority;
+            return a->seq < b->seq;
+        }
+    };
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::set<job*, job_order> ready;
+    std::vector<std::thread> workers;
+    ui64 nextSeq = 0;
+    bool stopping = false;
+
+    /*******************************************
+     * @brief Drops the pending slices of a job.
+     *******************************************/
+    void cancel(job *j) {
+        std::shared_ptr<job> last;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (!j->self || j->cancelled || j->finishing) return;
+            j->cancelled = true;
+            if (j->queued) {
+                ready.erase(j);
+                j->queued = false;
+            }
+            if (j->claimed == j->done) {
+                j->finishing = true;
+                last = j->self;
+            }
+        }
+        if (last) finish(last, true);
+    }
+
+    /*******************************************
+     * @brief Fulfils the promise once no slice is in flight.
+     *
+     * Runs outside the lock; the caller set j->finishing under the lock,
+     * so this runs once per job, and the outcome is passed in as decided
+     * there rather than re-read from j->cancelled.
+     *
+     * @param j Job.
+     * @param cancelled Whether the job was cancelled before completing.
+     *******************************************/
+    void finish(const std::shared_ptr<job> &j, bool cancelled) {
+        if (cancelled) {
+            j->promise.set_exception(std::make_exception_ptr(pricing_cancelled()));
+        } else {
+            double sum = 0.0, sumSq = 0.0;
+            for (ui64 s = 0; s < j->nSlices; s++) {
+                sum += j->sliceSum[s];
+                sumSq += j->sliceSumSq[s];
+            }
+            const pricing_params &p = j->params;
+            double N = double(p.nSim);
+            double mean = sum / N;
+            double var = std::max(sumSq / N - mean * mean, 0.0);
+            double disc = std::exp(-p.r * p.T);
+            j->promise.set_value({disc * mean, disc * std::sqrt(var / N)});
+        }
+        // Drop the self reference outside the lock: destroying the job
+        // destroys its stop callback, which waits for a running cancel().
+        std::shared_ptr<job> self;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            self.swap(j->self);
+        }
+    }
+
+    /*******************************************
+     * @brief Takes slices of the most urgent job until the engine stops.
+     *******************************************/
+    void worker_loop() {
+        for (;;) {
+            std::shared_ptr<job> j;
+            ui64 slice;
+            {
+                std::unique_lock<std::mutex> lk(m);
+                cv.wait(lk, [&] { return stopping || !ready.empty(); });
+                if (ready.empty()) return;
+                job *top = *ready.begin();
+                j = top->self;
+                slice = top->claimed++;
+                if (top->claimed == top->nSlices) {
+                    ready.erase(ready.begin());
+                    top->queued = false;
+                }
+            }
+
+            price_slice(j->params, slice, j->sliceSum[slice], j->sliceSumSq[slice]);
+
+            bool last, cancelled;
+            {
+                std::lock_guard<std::mutex> lk(m);
+                j->done++;
+                cancelled = j->cancelled;
+                last = j->done == j->claimed && (cancelled || j->done == j->nSlices);
+                if (last) j->finishing = true;
+            }
+            if (last) finish(j, cancelled);
+        }
+    }
+};
+
+/*******************************************
+ * @brief Closed-form Black-Scholes price, used to check the engine.
+ *******************************************/
+static double bs_closed_form(const pricing_params &p) {
+    return bsm_price(p.S0, p.K, p.T, p.r, 0.0, p.sigma, p.isCall);
+}
+
+/*******************************************
+ * @brief Main function: overlaps a bulk batch with urgent quotes.
+ *
+ * Queues the bulk jobs at priority 0, cancels the last one, then submits
+ * urgent quotes at priority 10 while the batch runs and reports their
+ * latency next to the batch completion time.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <bulk_jobs> <num_sims> [urgent_jobs] [threads]\n";
+        return 1;
+    }
+    int nBulk = std::max(1, std::atoi(argv[1]));
+    ui64 nSim = std::stoull(argv[2]);
+    int nUrgent = (argc > 3) ? std::atoi(argv[3]) : 8;
+    int nThreads = (argc > 4) ? std::atoi(argv[4])
+                              : int(std::max(1u, std::thread::hardware_concurrency()));
+
+    pricing_engine engine(nThreads);
+
+    double t1 = dml_micros();
+
+    std::vector<std::future<pricing_result>> bulk;
+    std::vector<pricing_params> bulkParams;
+    std::stop_source cancelLast;
+    for (int i = 0; i < nBulk; i++) {
+        pricing_params p = {100.0, 80.0 + 40.0 * i / nBulk, 1.0, 0.06, 0.2, i & 1, nSim, ui64(i)};
+        bulkParams.push_back(p);
+        bulk.push_back(engine.price_async(p, 0, i == nBulk - 1 ? cancelLast.get_token()
+                                                               : std::stop_token()));
+    }
+    cancelLast.request_stop();
+
+    // Urgent quotes arrive while the batch is running.
+    std::vector<double> urgentLat;
+    for (int i = 0; i < nUrgent; i++) {
+        pricing_params p = {100.0, 110.0, 0.5, 0.06, 0.25, 1, SLICE, ui64(1000 + i)};
+        double t0 = dml_micros();
+        pricing_result res = engine.price_async(p, 10).get();
+        urgentLat.push_back(dml_micros() - t0);
+        if (!(std::fabs(res.price - bs_closed_form(p)) < 5.0 * res.stdError + 1e-9)) {
+            std::cerr << "urgent quote " << i << " off: " << res.price << "\n";
+        }
+    }
+
+    double maxErr = 0.0, sumPrice = 0.0;
+    int nCancelled = 0, nDone = 0, nFailed = 0;
+    for (int i = 0; i < nBulk; i++) {
+        try {
+            pricing_result res = bulk[i].get();
+            maxErr = std::max(maxErr, std::fabs(res.price - bs_closed_form(bulkParams[i])) / res.stdError);
+            sumPrice += res.price;
+            nDone++;
+        } catch (const pricing_cancelled &) {
+            nCancelled++;
+        } catch (const std::exception &e) {
+            std::cerr << "bulk job " << i << " failed: " << e.what() << "\n";
+            nFailed++;
+        }
+    }
+    double t2 = dml_micros();
+
+    std::sort(urgentLat.begin(), urgentLat.end());
+    double elapsed = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(6)
+              << "bulk_done= " << nDone << "   cancelled= " << nCancelled
+              << "   failed= " << nFailed << "   max_err_in_stderr= " << maxErr << "\n";
+    if (!urgentLat.empty()) {
+        std::cout << std::setprecision(1)
+                  << "urgent latency us: p50= " << urgentLat[urgentLat.size() / 2]
+                  << "   max= " << urgentLat.back() << "\n";
+    }
+    std::cout << std::setprecision(6)
+              << "value= " << (nDone ? sumPrice / nDone : 0.0)
+              << " in " << elapsed << " s\n";
+    return nFailed ? 1 : 0;
+}
@@ -0,0 +1,526 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Heston / Bates calibration to an implied-volatility surface.
+
+    Usage: ./BSM_calibration [heston|bates] [--warm <file>] [--noise <vol_bp>]
+
+    Quotes are priced with the COS method (Fang & Oosterlee). The
+    characteristic function of the log-return does not depend on the
+    strike, so per maturity it is evaluated once per parameter vector
+    and folded with the put payoff coefficients into two cached arrays;
+    each strike then costs one cos/sin sum. Calls come from parity.
+
+    Levenberg-Marquardt minimises vega-weighted price residuals (about
+    implied-vol errors). The forward-difference Jacobian is one task per
+    (parameter, maturity) pair, run in parallel with OpenMP. Parameters
+    are kept feasible by projection after each step.
+
+    The market is synthetic: a surface generated from known parameters
+    (plus optional noise), then a second "intraday" surface with moved
+    parameters, refitted from the first fit. --warm reads the starting
+    point from a file written by the previous run and writes the new
+    fit back to it.
+*/
+
+/*******************************************
+ * @brief Black-Scholes price and vega (continuous dividend yield).
+ *******************************************/
+static void bs_price_vega(double S0, double K, double T, double r, double q, double sigma,
+                          int isCall, double &price, double &vega) {
+    double d1 = (std::log(S0 / K) + (r - q + 0.5 * sigma * sigma) * T) / (sigma * std::sqrt(T));
+    price = bsm_price(S0, K, T, r, q, sigma, isCall);
+    vega = S0 * std::exp(-q * T) * std::sqrt(T) * norm_pdf(d1);
+}
+
+/*******************************************
+ * @brief Implied volatility by safeguarded Newton (setup only).
+ *******************************************/
+static double implied_vol(double P, double S0, double K, double T, double r, double q, int isCall) {
+    double lo = 1e-4, hi = 5.0, s = 0.3;
+    for (int it = 0; it < 100; it++) {
+        double p, v;
+        bs_price_vega(S0, K, T, r, q, s, isCall, p, v);
+        if (p > P) hi = s; else lo = s;
+        double next = (v > 1e-12) ? s - (p - P) / v : 0.5 * (lo + hi);
+        if (!(next > lo && next < hi)) next = 0.5 * (lo + hi);
+        if (std::fabs(next - s) < 1e-12) return next;
+        s = next;
+    }
+    return s;
+}
+
+/*******************************************
+ * @brief Model parameters: Heston, plus Merton jumps for Bates.
+ *
+ * Order in p[]: v0, kappa, theta, xi, rho, lambda, muJ, sigmaJ.
+ *******************************************/
+#define MAX_PARAMS 8
+static const char *PARAM_NAMES[MAX_PARAMS] = {"v0", "kappa", "theta", "xi", "rho",
+                                              "lambda", "muJ", "sigmaJ"};
+
+struct model_params {
+    int n;                      // 5 (Heston) or 8 (Bates)
+    double p[MAX_PARAMS];
+
+    /*******************************************
+     * @brief Projects onto the feasible set.
+     *******************************************/
+    void project() {
+        p[0] = std::min(std::max(p[0], 1e-4), 2.0);
+        p[1] = std::min(std::max(p[1], 1e-3), 20.0);
+        p[2] = std::min(std::max(p[2], 1e-4), 2.0);
+        p[3] = std::min(std::max(p[3], 1e-3), 5.0);
+        p[4] = std::min(std::max(p[4], -0.999), 0.999);
+        if (n > 5) {
+            p[5] = std::min(std::max(p[5], 0.0), 5.0);
+            p[6] = std::min(std::max(p[6], -1.0), 1.0);
+            p[7] = std::min(std::max(p[7], 1e-3), 1.0);
+        }
+    }
+};
+
+/*******************************************
+ * @brief Characteristic function of ln(S_T / S0) (Heston, Bates).
+ *
+ * Uses the "little Heston trap" form (Albrecher et al.), which keeps
+ * the complex logarithm on its principal branch for long maturities.
+ *******************************************/
+static std::complex<double> log_return_cf(double u, double T, double r, double q,
+                                          const model_params &m) {
+    typedef std::complex<double> cd;
+    const cd i(0.0, 1.0);
+    const double v0 = m.p[0], kappa = m.p[1], theta = m.p[2], xi = m.p[3], rho = m.p[4];
+    cd beta = kappa - rho * xi * i * u;
+    cd d = std::sqrt(beta * beta + xi * xi * (i * u + u * u));
+    cd g = (beta - d) / (beta + d);
+    cd e = std::exp(-d * T);
+    cd C = kappa * theta / (xi * xi) * ((beta - d) * T - 2.0 * std::log((1.0 - g * e) / (1.0 - g)));
+    cd D = (beta - d) / (xi * xi) * (1.0 - e) / (1.0 - g * e);
+    cd ln = i * u * (r - q) * T + C + D * v0;
+    if (m.n > 5) {
+        const double lambda = m.p[5], muJ = m.p[6], sJ = m.p[7];
+        double kbar = std::exp(muJ + 0.5 * sJ * sJ) - 1.0;
+        ln += lambda * T * (std::exp(i * u * muJ - 0.5 * sJ * sJ * u * u) - 1.0)
+            - i * u * lambda * T * kbar;
+    }
+    return std::exp(ln);
+}
+
+/*******************************************
+ * @brief Quotes grouped by maturity.
+ *******************************************/
+struct vol_surface {
+    double S0, r, q;
+    std::vector<double> T;          // maturities
+    std::vector<int> first;         // first quote of each maturity (size nT + 1)
+    std::vector<double> K, price, vol, weight;
+    std::vector<int> isCall;
+};
+
+#define COS_TERMS 160
+#define COS_L 10.0
+
+/*******************************************
+ * @brief Cached COS sums for one maturity and one parameter vector.
+ *
+ * put(K) = K e^{-rT} sum_k [A_k cos(u_k (x - a)) - B_k sin(u_k (x - a))],
+ * x = ln(S0/K), with A + iB = w_k * phi(u_k) * V_k, V_k the put payoff
+ * coefficients on [a, b].
+ *******************************************/
+struct cos_cache {
+    double a, du;
+    alignas(64) double A[COS_TERMS];
+    alignas(64) double B[COS_TERMS];
+
+    void build(double T, double r, double q, const model_params &m) {
+        const double v0 = m.p[0], kappa = m.p[1], theta = m.p[2], xi = m.p[3];
+        // Mean and a generous variance of the log-return set the range.
+        double ekt = std::exp(-kappa * T);
+        double c1 = (r - q) * T + (1.0 - ekt) * (theta - v0) / (2.0 * kappa) - 0.5 * theta * T;
+        double w = std::max(v0, theta) * T * (1.0 + xi);
+        if (m.n > 5) w += m.p[5] * T * (m.p[6] * m.p[6] + m.p[7] * m.p[7]);
+        double half = COS_L * std::sqrt(w);
+        a = c1 - half;
+        double b = c1 + half;
+        du = M_PI / (b - a);
+        for (int k = 0; k < COS_TERMS; k++) {
+            double u = k * du;
+            // Put payoff (1 - e^y)^+ on [a, 0]: V_k = 2/(b-a) (psi_k - chi_k).
+            double ca = std::cos(-u * a), sa = std::sin(-u * a);
+            double chi = (ca - std::exp(a) + u * sa) / (1.0 + u * u);
+            double psi = (k == 0) ? -a : sa / u;
+            double V = 2.0 / (b - a) * (psi - chi);
+            std::complex<double> phi = log_return_cf(u, T, r, q, m);
+            double wk = (k == 0) ? 0.5 : 1.0;
+            A[k] = wk * V * phi.real();
+            B[k] = wk * V * phi.imag();
+        }
+    }
+
+    double put(double S0, double K, double T, double r) const {
+        double y = std::log(S0 / K) - a;
+        double s = 0.0;
+        #pragma omp simd reduction(+:s)
+        for (int k = 0; k < COS_TERMS; k++) {
+            double t = k * du * y;
+            s += A[k] * std::cos(t) - B[k] * std::sin(t);
+        }
+        return K * std::exp(-r * T) * s;
+    }
+};
+
+/*******************************************
+ * @brief Model prices of one maturity slice.
+ *
+ * @param S Surface.
+ * @param m Parameters.
+ * @param t Maturity index.
+ * @param out Model prices (indexed like the quotes).
+ *******************************************/
+static void price_slice(const vol_surface &S, const model_params &m, int t, double *out) {
+    cos_cache c;
+    const double T = S.T[t];
+    c.build(T, S.r, S.q, m);
+    for (int i = S.first[t]; i < S.first[t + 1]; i++) {
+        double P = c.put(S.S0, S.K[i], T, S.r);
+        out[i] = S.isCall[i] ? P + S.S0 * std::exp(-S.q * T) - S.K[i] * std::exp(-S.r * T) : P;
+    }
+}
+
+/*******************************************
+ * @brief Weighted residuals (model - market) / vega for all quotes.
+ *******************************************/
+static void residuals(const vol_surface &S, const model_params &m, std::vector<double> &res) {
+    const int nT = int(S.T.size());
+    res.resize(S.K.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < nT; t++) {
+        price_slice(S, m, t, res.data());
+        for (int i = S.first[t]; i < S.first[t + 1]; i++) res[i] = (res[i] - S.price[i]) * S.weight[i];
+    }
+}
+
+/*******************************************
+ * @brief Residuals and forward-difference Jacobian in one parallel pass.
+ *
+ * Task (j, t) prices maturity t with parameter j - 1 bumped (j = 0 is
+ * the base point), so the CF cache of each task serves all of its
+ * strikes and the (n + 1) * nT tasks spread over the threads.
+ *
+ * @param S Surface.
+ * @param m Parameters.
+ * @param res Residuals (output).
+ * @param J Jacobian, row-major [quote][param] (output).
+ *******************************************/
+static void residuals_jacobian(const vol_surface &S, const model_params &m,
+                               std::vector<double> &res, std::vector<double> &J) {
+    const int nT = int(S.T.size()), n = m.n;
+    const size_t nQ = S.K.size();
+    std::vector<double> cols((n + 1) * nQ);
+    double h[MAX_PARAMS];
+    for (int j = 0; j < n; j++) h[j] = 1e-6 * std::max(std::fabs(m.p[j]), 0.1);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic, 1)
+    for (int j = 0; j <= n; j++) {
+        for (int t = 0; t < nT; t++) {
+            model_params b = m;
+            if (j > 0) b.p[j - 1] += h[j - 1];
+            price_slice(S, b, t, cols.data() + j * nQ);
+        }
+    }
+
+    res.resize(nQ);
+    J.assign(nQ * n, 0.0);
+    for (size_t i = 0; i < nQ; i++) {
+        res[i] = (cols[i] - S.price[i]) * S.weight[i];
+        for (int j = 0; j < n; j++)
+            J[i * n + j] = (cols[(j + 1) * nQ + i] - cols[i]) / h[j] * S.weight[i];
+    }
+}
+
+/*******************************************
+ * @brief Solves the small SPD system A x = b by Cholesky (in place).
+ *
+ * @return False if A is not positive definite.
+ *******************************************/
+static bool cholesky_solve(std::vector<double> A, std::vector<double> &b, int n) {
+    for (int j = 0; j < n; j++) {
+        double d = A[j * n + j];
+        for (int k = 0; k < j; k++) d -= A[j * n + k] * A[j * n + k];
+        if (d <= 0.0) return false;
+        d = std::sqrt(d);
+        A[j * n + j] = d;
+        for (int i = j + 1; i < n; i++) {
+            double s = A[i * n + j];
+            for (int k = 0; k < j; k++) s -= A[i * n + k] * A[j * n + k];
+            A[i * n + j] = s / d;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        double s = b[i];
+        for (int k = 0; k < i; k++) s -= A[i * n + k] * b[k];
+        b[i] = s / A[i * n + i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double s = b[i];
+        for (int k = i + 1; k < n; k++) s -= A[k * n + i] * b[k];
+        b[i] = s / A[i * n + i];
+    }
+    return true;
+}
+
+/*******************************************
+ * @brief Outcome of a calibration.
+ *******************************************/
+struct fit_result {
+    model_params m;
+    int iterations;
+    int evaluations;
+    double rmsVol;              // root mean square implied-vol error
+    double seconds;
+};
+
+/*******************************************
+ * @brief Levenberg-Marquardt with Marquardt's diagonal scaling.
+ *
+ * @param S Surface.
+ * @param start Starting point.
+ * @return Fitted parameters and statistics.
+ *******************************************/
+static fit_result calibrate(const vol_surface &S, model_params start) {
+    double t0 = dml_micros();
+    const int n = start.n;
+    const size_t nQ = S.K.size();
+    model_params m = start;
+    m.project();
+    std::vector<double> res, J, trial;
+    double lambda = 1e-3;
+    int it = 0, evals = 0;
+    double cost = 0.0;
+
+    residuals_jacobian(S, m, res, J);
+    evals += n + 1;
+    for (double v : res) cost += v * v;
+
+    for (it = 0; it < 100; it++) {
+        std::vector<double> A(n * n, 0.0), g(n, 0.0);
+        for (size_t i = 0; i < nQ; i++) {
+            const double *Ji = &J[i * n];
+            for (int a = 0; a < n; a++) {
+                g[a] -= Ji[a] * res[i];
+                for (int b = 0; b <= a; b++) A[a * n + b] += Ji[a] * Ji[b];
+            }
+        }
+        for (int a = 0; a < n; a++)
+            for (int b = a + 1; b < n; b++) A[a * n + b] = A[b * n + a];
+
+        bool improved = false;
+        double newCost = cost;
+        for (int tries = 0; tries < 12 && !improved; tries++) {
+            std::vector<double> Ad = A, step = g;
+            for (int a = 0; a < n; a++) Ad[a * n + a] += lambda * std::max(A[a * n + a], 1e-12);
+            if (!cholesky_solve(Ad, step, n)) { lambda *= 4.0; continue; }
+            model_params cand = m;
+            for (int a = 0; a < n; a++) cand.p[a] += step[a];
+            cand.project();
+            residuals(S, cand, trial);
+            evals++;
+            double c = 0.0;
+            for (double v : trial) c += v * v;
+            if (c < cost) {
+                m = cand;
+                newCost = c;
+                improved = true;
+                lambda = std::max(lambda / 3.0, 1e-9);
+            } else {
+                lambda *= 4.0;
+            }
+        }
+        if (!improved) break;
+        bool converged = (cost - newCost) <= 1e-10 * cost || newCost < 1e-16 * double(nQ);
+        cost = newCost;
+        if (converged) { it++; break; }
+        residuals_jacobian(S, m, res, J);
+        evals += n + 1;
+    }
+
+    fit_result f;
+    f.m = m;
+    f.iterations = it;
+    f.evaluations = evals;
+    f.rmsVol = std::sqrt(cost / double(nQ));
+    f.seconds = (dml_micros() - t0) * 1e-6;
+    return f;
+}
+
+/*******************************************
+ * @brief Builds a surface from model parameters.
+ *
+ * 10 maturities from 1 month to 5 years, 15 strikes per maturity from
+ * -2 to +2 standard deviations around the forward; out-of-the-money
+ * puts below the forward, calls above. Optional Gaussian noise on the
+ * implied vols (basis points).
+ *******************************************/
+static vol_surface make_surface(const model_params &truth, double noiseBp, ui64 seed) {
+    vol_surface S;
+    S.S0 = 100.0;
+    S.r = 0.06;
+    S.q = 0.0;
+    S.T = {1.0 / 12, 2.0 / 12, 0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 3.0, 5.0};
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, seed);
+    for (size_t t = 0; t < S.T.size(); t++) {
+        S.first.push_back(int(S.K.size()));
+        double T = S.T[t], F = S.S0 * std::exp((S.r - S.q) * T);
+        double sd = std::sqrt(truth.p[2] * T);
+        for (int k = 0; k < 15; k++) {
+            double z = -2.0 + 4.0 * k / 14.0;
+            S.K.push_back(F * std::exp(z * sd));
+            S.isCall.push_back(z >= 0.0 ? 1 : 0);
+        }
+    }
+    S.first.push_back(int(S.K.size()));
+    S.price.resize(S.K.size());
+    for (size_t t = 0; t < S.T.size(); t++) price_slice(S, truth, int(t), S.price.data());
+
+    S.vol.resize(S.K.size());
+    S.weight.resize(S.K.size());
+    for (size_t t = 0; t < S.T.size(); t++) {
+        for (int i = S.first[t]; i < S.first[t + 1]; i++) {
+            double iv = implied_vol(S.price[i], S.S0, S.K[i], S.T[t], S.r, S.q, S.isCall[i]);
+            if (noiseBp > 0.0) {
+                double u1 = uniform01(rng), u2 = uniform01(rng), z, unused;
+                box_muller_pair(u1, u2, z, unused);
+                iv += 1e-4 * noiseBp * z;
+            }
+            double p, vega;
+            bs_price_vega(S.S0, S.K[i], S.T[t], S.r, S.q, iv, S.isCall[i], p, vega);
+            S.vol[i] = iv;
+            S.price[i] = p;
+            S.weight[i] = 1.0 / std::max(vega, 1e-3);
+        }
+    }
+    return S;
+}
+
+/*******************************************
+ * @brief Reads a warm start ("heston|bates p0 p1 ...") if it matches.
+ *******************************************/
+static bool load_params(const std::string &path, model_params &m) {
+    std::ifstream f(path);
+    std::string kind;
+    if (!(f >> kind) || kind != (m.n > 5 ? "bates" : "heston")) return false;
+    model_params t = m;
+    for (int j = 0; j < m.n; j++) if (!(f >> t.p[j])) return false;
+    m = t;
+    return true;
+}
+
+static void save_params(const std::string &path, const model_params &m) {
+    std::string tmp = path + ".tmp";
+    std::ofstream f(tmp);
+    f << (m.n > 5 ? "bates" : "heston") << std::setprecision(17);
+    for (int j = 0; j < m.n; j++) f << " " << m.p[j];
+    f << "\n";
+    f.close();
+    if (f) std::rename(tmp.c_str(), path.c_str());
+}
+
+/*******************************************
+ * @brief Prints a fit next to the parameters used for the market.
+ *******************************************/
+static void print_fit(const char *label, const fit_result &f, const model_params &truth) {
+    std::cout << label << ": iterations= " << f.iterations << "   surface evaluations= "
+              << f.evaluations << "   rms vol error= " << std::fixed << std::setprecision(2)
+              << f.rmsVol * 1e4 << " bp   time= " << std::setprecision(4) << f.seconds << " s\n";
+    for (int j = 0; j < f.m.n; j++) {
+        std::cout << "    " << std::left << std::setw(7) << PARAM_NAMES[j] << std::right
+                  << std::setprecision(5) << std::setw(10) << f.m.p[j]
+                  << "   (market " << truth.p[j] << ")\n";
+    }
+}
+
+/*******************************************
+ * @brief Main function: COS check, cold (or warm) fit, intraday refit.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    bool bates = false;
+    std::string warmPath;
+    double noiseBp = 0.0;
+    for (int a = 1; a < argc; a++) {
+        std::string opt = argv[a];
+        if (opt == "heston") bates = false;
+        else if (opt == "bates") bates = true;
+        else if (opt == "--warm" && a + 1 < argc) warmPath = argv[++a];
+        else if (opt == "--noise" && a + 1 < argc) noiseBp = std::atof(argv[++a]);
+        else {
+            std::cerr << "Usage: " << argv[0] << " [heston|bates] [--warm <file>] [--noise <vol_bp>]\n";
+            return 1;
+        }
+    }
+
+    // Fang & Oosterlee (2008), Heston test case: call = 5.785155450.
+    {
+        model_params fo = {5, {0.0175, 1.5768, 0.0398, 0.5751, -0.5711}};
+        cos_cache c;
+        c.build(1.0, 0.0, 0.0, fo);
+        double call = c.put(100.0, 100.0, 1.0, 0.0);     // ATM, r = q = 0: call = put
+        std::cout << "COS check (Fang-Oosterlee Heston, " << COS_TERMS << " terms): error= "
+                  << std::scientific << std::setprecision(2) << call - 5.785155450 << "\n";
+    }
+
+    model_params truth = {5, {0.04, 1.5, 0.06, 0.5, -0.7}};
+    if (bates) truth = {8, {0.04, 1.5, 0.06, 0.5, -0.7, 0.3, -0.1, 0.15}};
+    model_params start = {truth.n, {0.1, 1.0, 0.1, 0.3, -0.3, 0.1, 0.0, 0.1}};
+    bool warm = !warmPath.empty() && load_params(warmPath, start);
+
+    vol_surface S = make_surface(truth, noiseBp, 0xC0FFEEULL);
+    std::cout << std::defaultfloat << (bates ? "Bates" : "Heston") << "   quotes= " << S.K.size()
+              << "   maturities= " << S.T.size() << "   noise= " << noiseBp << " bp"
+              << "   threads= " << omp_get_max_threads() << std::endl;
+
+    double t1 = dml_micros();
+    fit_result f1 = calibrate(S, start);
+    print_fit(warm ? "fit (warm start from file)" : "fit (cold start)", f1, truth);
+
+    // Intraday move: spot variance up 10%, skew steeper.
+    model_params moved = truth;
+    moved.p[0] *= 1.1;
+    moved.p[4] -= 0.05;
+    vol_surface S2 = make_surface(moved, noiseBp, 0xBEEFULL);
+    fit_result f2 = calibrate(S2, f1.m);
+    print_fit("intraday refit (warm start)", f2, moved);
+    double t2 = dml_micros();
+
+    if (!warmPath.empty()) save_params(warmPath, f2.m);
+
+    // Fitted 1y K=110 call, for comparison with the other programs.
+    std::vector<double> one(1);
+    vol_surface ref = S2;
+    ref.T = {1.0};
+    ref.first = {0, 1};
+    ref.K = {110.0};
+    ref.isCall = {1};
+    price_slice(ref, f2.m, 0, one.data());
+    std::cout << std::fixed << std::setprecision(6)
+              << "value= " << one[0] << " in " << (t2 - t1) * 1e-6 << " s\n";
+    return 0;
+}
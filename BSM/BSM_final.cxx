@@ -1,89 +1,273 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <omp.h>
-#include <sys/time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
 #include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 #include <amath.h>
 #include <armpl.h>
+#include "BSM_kernels.h"
 
-#define ui64 uint64_t
+static const int MAX_CHUNK = 2048;
 
 /*******************************************
- * @brief Returns the current time in microseconds.
+ * @brief Per-thread bump allocator living for the whole process.
  *
- * @return Current time in microseconds.
+ * Backed by one anonymous mapping (optionally transparent huge pages),
+ * handing out 64-byte aligned blocks. Callers take a mark, allocate,
+ * and roll back to the mark when done, so steady-state runs never touch
+ * the system allocator.
  *******************************************/
-static double dml_micros() {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return double(tv.tv_sec) * 1e6 + double(tv.tv_usec);
+struct alignas(64) scratch_arena {
+    char* map = nullptr;
+    size_t mapBytes = 0;
+    char* base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+
+    ~scratch_arena() {
+        if (map) munmap(map, mapBytes);
+    }
+};
+
+static const size_t ARENA_BYTES = 2u << 20; // One 2 MiB huge page.
+static bool g_hugepages = false;
+
+/*******************************************
+ * @brief Arena of the calling thread, mapped on first use.
+ *
+ * The first call happens in the (pinned) worker itself, so the pages
+ * are first-touched on its NUMA node.
+ *
+ * @return Thread-local arena.
+ *******************************************/
+static scratch_arena& thread_arena() {
+    static thread_local scratch_arena a;
+    if (!a.base) {
+        // Over-map by one huge page so the arena can start on a 2 MiB boundary.
+        size_t bytes = 2 * ARENA_BYTES;
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            std::cerr << "scratch arena: mmap failed\n";
+            std::abort();
+        }
+        a.map = static_cast<char*>(p);
+        a.mapBytes = bytes;
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(p) + ARENA_BYTES - 1) & ~uintptr_t(ARENA_BYTES - 1);
+        a.base = reinterpret_cast<char*>(aligned);
+        a.capacity = ARENA_BYTES;
+#ifdef MADV_HUGEPAGE
+        if (g_hugepages) madvise(a.base, a.capacity, MADV_HUGEPAGE);
+#endif
+        std::memset(a.base, 0, a.capacity);
+    }
+    return a;
 }
 
 /*******************************************
- * @brief XORSHIFT128+ pseudo-random number generator initialization.
+ * @brief Allocates n doubles from an arena, 64-byte aligned.
  *
- * @param st XORSHIFT state.
- * @param seed Initial seed.
+ * @param a Arena.
+ * @param n Number of doubles.
+ * @return Pointer into the arena.
  *******************************************/
-struct xorshift128plus_state {
-    ui64 s[2];
+static double* arena_doubles(scratch_arena &a, size_t n) {
+    size_t off = (a.used + 63) & ~size_t(63);
+    size_t end = off + n * sizeof(double);
+    if (end > a.capacity) {
+        std::cerr << "scratch arena exhausted\n";
+        std::abort();
+    }
+    a.used = end;
+    return reinterpret_cast<double*>(a.base + off);
+}
+
+/*******************************************
+ * @brief Placement of one worker, one cache line apart.
+ *******************************************/
+struct alignas(64) thread_slot {
+    int cpu;
+    int node;
 };
 
-static inline void xorshift128plus_init(xorshift128plus_state &st, ui64 seed) {
-    st.s[0] = seed;
-    st.s[1] = seed ^ 0x9E3779B97F4A7C15ULL;
-}
+static std::vector<thread_slot> g_slots;
+
+/*******************************************
+ * @brief Live progress of one worker, one cache line apart.
+ *
+ * paths is bumped once per block by the kernel; runs, sum and sumSq
+ * once per completed run by the worker that owns the slot. All
+ * accesses are relaxed: the sampler only needs each value to be
+ * eventually visible, not consistent with the others.
+ *******************************************/
+struct alignas(64) thread_progress {
+    std::atomic<ui64> paths{0};
+    std::atomic<ui64> runs{0};
+    std::atomic<double> sum{0.0};
+    std::atomic<double> sumSq{0.0};
+};
+
+static std::vector<thread_progress> g_progress;
+
+// Slot of the worker running on this thread, null when telemetry is off.
+static thread_local thread_progress *tl_progress = nullptr;
 
 /*******************************************
- * @brief XORSHIFT128+ pseudo-random number generator.
+ * @brief Parses a sysfs CPU list such as "0-47,96-143".
  *
- * @param st XORSHIFT state.
- * @return Random 64-bit unsigned integer.
+ * @param list CPU list string.
+ * @return CPU indices.
  *******************************************/
-static inline ui64 xorshift128plus(xorshift128plus_state &st) {
-    ui64 x = st.s[0];
-    ui64 y = st.s[1];
-    st.s[0] = y;
-    x ^= x << 23;
-    x ^= x >> 17;
-    x ^= y ^ (y >> 26);
-    st.s[1] = x;
-    return x + y;
+static std::vector<int> parse_cpulist(const std::string &list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        size_t dash = item.find('-');
+        if (!item.empty() && item[0] >= '0' && item[0] <= '9') {
+            int lo = std::atoi(item.c_str());
+            int hi = (dash == std::string::npos) ? lo : std::atoi(item.c_str() + dash + 1);
+            for (int c = lo; c <= hi; c++) cpus.push_back(c);
+        }
+        pos = end + 1;
+    }
+    return cpus;
 }
 
 /*******************************************
- * @brief Box-Muller transform without rejection.
+ * @brief Lists the CPUs this process may use, ordered by NUMA node.
+ *
+ * Reads /sys/devices/system/node; machines without it are treated as a
+ * single node.
  *
- * @param u1 Uniform random variable in [0, 1).
- * @param u2 Uniform random variable in [0, 1).
- * @return Standard normal random variable.
+ * @param nodeOf Output NUMA node of each returned CPU.
+ * @return Usable CPUs, node 0 first.
  *******************************************/
-__attribute__((always_inline)) static inline double box_muller_no_reject(double u1, double u2) {
-    if (u1 < 1e-16) u1 = 1e-16; // Clamp to avoid log(0)
-    double r = std::sqrt(-2.0 * std::log(u1));
-    double theta = 2.0 * M_PI * u2;
-    return r * std::cos(theta);
+static std::vector<int> read_topology(std::vector<int> &nodeOf) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<int> cpus;
+    nodeOf.clear();
+    for (int n = 0; n < 1024; n++) {
+        std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        if (!f) {
+            if (n == 0) break;
+            continue;
+        }
+        std::string list;
+        std::getline(f, list);
+        for (int c : parse_cpulist(list)) {
+            if (c < CPU_SETSIZE && CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+                nodeOf.push_back(n);
+            }
+        }
+    }
+    if (cpus.empty()) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &allowed)) {
+                cpus.push_back(c);
+                nodeOf.push_back(0);
+            }
+        }
+    }
+    return cpus;
 }
 
 /*******************************************
- * @brief Approximates exponential with clamping.
+ * @brief Pins the OpenMP workers and first-touches their arenas.
+ *
+ * Threads fill the first NUMA node before moving to the next one
+ * (compact placement). Pinning is skipped when OMP_PROC_BIND is set so
+ * the runtime's own policy wins. Prints the placement map.
  *
- * @param x Input value.
- * @return Approximated exponential value.
+ * @param pin Whether to pin threads to CPUs.
  *******************************************/
-__attribute__((always_inline)) static inline double exp_approx_clamp(double x) {
-    if (x < -10.0) x = -10.0;
-    else if (x > 10.0) x = 10.0;
-    double x2 = x * x;
-    double x3 = x2 * x;
-    return 1.0 + x + 0.5 * x2 + (1.0 / 6.0) * x3;
+static void setup_thread_slots(bool pin) {
+    std::vector<int> nodeOf;
+    std::vector<int> cpus = read_topology(nodeOf);
+    if (std::getenv("OMP_PROC_BIND")) pin = false;
+
+    int nThreads = omp_get_max_threads();
+    g_slots.assign(nThreads, thread_slot{-1, -1});
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int t = omp_get_thread_num();
+        thread_slot &slot = g_slots[t];
+        if (pin && !cpus.empty()) {
+            int k = t % int(cpus.size());
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[k], &set);
+            if (sched_setaffinity(0, sizeof(set), &set) == 0) {
+                slot.cpu = cpus[k];
+                slot.node = nodeOf[k];
+            }
+        }
+        if (slot.cpu < 0) {
+            slot.cpu = sched_getcpu();
+            auto it = std::find(cpus.begin(), cpus.end(), slot.cpu);
+            slot.node = (it == cpus.end()) ? 0 : nodeOf[it - cpus.begin()];
+        }
+        thread_arena();
+    }
+
+    std::cout << "Placement (" << (pin ? "pinned" : "unpinned") << ", thread:cpu/node):";
+    for (int t = 0; t < nThreads; t++) {
+        if (t % 8 == 0) std::cout << "\n ";
+        std::cout << " " << t << ":" << g_slots[t].cpu << "/" << g_slots[t].node;
+    }
+    std::cout << std::endl;
 }
 
+/*******************************************
+ * @brief Kernel shape selected by the auto-tuner.
+ *
+ * chunk: paths per block (power of two, at most MAX_CHUNK).
+ * threads: workers used for the run loop.
+ *
+ * There is no unroll factor: every uniform depends on the previous
+ * generator state, so unrolling the generation loop cannot overlap
+ * draws.
+ *******************************************/
+struct kernel_tuning {
+    int chunk;
+    int threads;
+};
+
+static kernel_tuning g_tune = {256, 0};
+
+
 /*******************************************
  * @brief Monte Carlo kernel with fused approach.
  *
+ * The generators are consumed in the same order whatever the chunk, so
+ * the tuning only changes summation grouping.
+ *
+ * @tparam Payoff Payoff policy.
+ * @tparam Model Model policy.
+ * @tparam Rng RNG policy.
  * @param S0 Initial stock price.
  * @param K Strike price.
  * @param T Time to maturity.
@@ -91,82 +275,453 @@ __attribute__((always_inline)) static inline double exp_approx_clamp(double x) {
  * @param sigma Volatility.
  * @param nSim Number of simulations.
  * @param runIndex Index of the current run.
+ * @param chunk Paths per block.
  * @return Discounted mean payoff.
  *******************************************/
-double black_scholes_monte_carlo_fused_noreject(
+template <class Payoff, class Model, class Rng>
+static double mc_fused_kernel(
     double S0, double K, double T, double r, double sigma,
-    ui64 nSim, ui64 runIndex) {
-    double drift = (r - 0.5 * sigma * sigma) * T;
-    double vol = sigma * std::sqrt(T);
+    ui64 nSim, ui64 runIndex, int chunk) {
+    const Model model(S0, T, r, sigma);
     double disc = std::exp(-r * T);
 
-    const int CHUNK = 256;
-    ui64 nBlocks = nSim / CHUNK;
-    ui64 reste = nSim % CHUNK;
+    ui64 nBlocks = nSim / chunk;
+    ui64 reste = nSim % chunk;
 
     double payoffSum = 0.0;
+    thread_progress *progress = tl_progress;
 
     #pragma omp parallel reduction(+:payoffSum)
     {
-        xorshift128plus_state rng;
+        Rng rng;
         ui64 myThreadId = (ui64)omp_get_thread_num() + 1;
-        ui64 seedBase = 0xDEADBEEF ^ (0xABCULL * myThreadId) ^ (0xA5ULL * (runIndex + 1));
-        xorshift128plus_init(rng, seedBase);
+        rng.seed(0xDEADBEEF ^ (0xABCULL * myThreadId) ^ (0xA5ULL * (runIndex + 1)));
 
-        double* u1 = new double[CHUNK];
-        double* u2 = new double[CHUNK];
+        scratch_arena& arena = thread_arena();
+        size_t mark = arena.used;
+        double* u1 = arena_doubles(arena, chunk);
+        double* u2 = arena_doubles(arena, chunk);
 
         #pragma omp for schedule(static)
         for (ui64 b = 0; b < nBlocks; b++) {
-            for (int i = 0; i < CHUNK; i++) {
-                ui64 rA = xorshift128plus(rng);
-                ui64 rB = xorshift128plus(rng);
-                u1[i] = double(rA) * (1.0 / 18446744073709551616.0);
-                u2[i] = double(rB) * (1.0 / 18446744073709551616.0);
+            for (int i = 0; i < chunk; i++) {
+                u1[i] = rng.next();
+                u2[i] = rng.next();
             }
-
-            double local = 0.0;
-            #pragma omp simd reduction(+:local)
-            for (int i = 0; i < CHUNK; i++) {
-                double g = box_muller_no_reject(u1[i], u2[i]);
-                double x = drift + vol * g;
-                double e = exp_approx_clamp(x);
-                double ST = S0 * e;
-                double pay = (ST > K) ? (ST - K) : 0.0;
-                local += pay;
-            }
-            payoffSum += local;
+            payoffSum += block_payoff_sum<Payoff>(model, K, u1, u2, chunk);
+            if (progress) progress->paths.fetch_add(chunk, std::memory_order_relaxed);
         }
 
         if (reste > 0) {
             for (ui64 i = 0; i < reste; i++) {
-                ui64 rA = xorshift128plus(rng);
-                ui64 rB = xorshift128plus(rng);
-                u1[i] = double(rA) * (1.0 / 18446744073709551616.0);
-                u2[i] = double(rB) * (1.0 / 18446744073709551616.0);
-            }
-
-            double local = 0.0;
-            #pragma omp simd reduction(+:local)
-            for (ui64 i = 0; i < reste; i++) {
-                double g = box_muller_no_reject(u1[i], u2[i]);
-                double x = drift + vol * g;
-                double e = exp_approx_clamp(x);
-                double ST = S0 * e;
-                double pay = (ST > K) ? (ST - K) : 0.0;
-                local += pay;
+                u1[i] = rng.next();
+                u2[i] = rng.next();
             }
-            payoffSum += local;
+            payoffSum += block_payoff_sum<Payoff>(model, K, u1, u2, int(reste));
+            if (progress) progress->paths.fetch_add(reste, std::memory_order_relaxed);
         }
 
-        delete[] u1;
-        delete[] u2;
+        arena.used = mark;
     }
 
     double meanPayoff = payoffSum / double(nSim);
     return disc * meanPayoff;
 }
 
+typedef double (*mc_kernel_fn)(double, double, double, double, double, ui64, ui64, int);
+
+enum product_kind { PRODUCT_CALL, PRODUCT_PUT, PRODUCT_DIGITAL };
+enum model_kind { MODEL_APPROX_EXP, MODEL_EXACT_EXP };
+
+static const char *PRODUCT_NAMES[] = {"call", "put", "digital"};
+static const char *MODEL_NAMES[] = {"approx", "exact"};
+
+static int g_product = PRODUCT_CALL;
+static int g_model = MODEL_APPROX_EXP;
+
+/*******************************************
+ * @brief Picks the kernel instance for a product and model.
+ *
+ * Every product x model pair is instantiated here, so each gets its own
+ * branch-free, fully inlined loop.
+ *******************************************/
+template <class Model>
+static mc_kernel_fn kernel_for_product(int product) {
+    switch (product) {
+    case PRODUCT_PUT:     return mc_fused_kernel<put_payoff, Model, xorshift_uniform_rng>;
+    case PRODUCT_DIGITAL: return mc_fused_kernel<digital_payoff, Model, xorshift_uniform_rng>;
+    default:              return mc_fused_kernel<call_payoff, Model, xorshift_uniform_rng>;
+    }
+}
+
+/*******************************************
+ * @brief Monte Carlo kernel with fused approach, using the current tuning
+ *        and the selected product and model.
+ *
+ * @param S0 Initial stock price.
+ * @param K Strike price.
+ * @param T Time to maturity.
+ * @param r Risk-free interest rate.
+ * @param sigma Volatility.
+ * @param nSim Number of simulations.
+ * @param runIndex Index of the current run.
+ * @return Discounted mean payoff.
+ *******************************************/
+double black_scholes_monte_carlo_fused_noreject(
+    double S0, double K, double T, double r, double sigma,
+    ui64 nSim, ui64 runIndex) {
+    mc_kernel_fn fn = (g_model == MODEL_EXACT_EXP)
+        ? kernel_for_product<exact_gbm_model>(g_product)
+        : kernel_for_product<approx_gbm_model>(g_product);
+    return fn(S0, K, T, r, sigma, nSim, runIndex, g_tune.chunk);
+}
+
+/*******************************************
+ * @brief Identifies the CPU model for the tuning cache.
+ *
+ * @return "model name" (x86) or implementer/part (Arm), plus CPU count.
+ *******************************************/
+static std::string cpu_model_key() {
+    std::ifstream f("/proc/cpuinfo");
+    std::string line, model, impl, part;
+    while (std::getline(f, line)) {
+        size_t c = line.find(':');
+        if (c == std::string::npos) continue;
+        std::string k = line.substr(0, line.find_last_not_of(" \t", c - 1) + 1);
+        std::string v = line.substr(std::min(line.size(), c + 2));
+        if (k == "model name" && model.empty()) model = v;
+        else if (k == "CPU implementer" && impl.empty()) impl = v;
+        else if (k == "CPU part" && part.empty()) part = v;
+    }
+    if (model.empty()) model = "arm-" + impl + "-" + part;
+    return model + " x" + std::to_string(sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+/*******************************************
+ * @brief Location of the per-host tuning file.
+ *
+ * @return $BSM_TUNING_FILE, else ~/.bsm_tuning.
+ *******************************************/
+static std::string tuning_path() {
+    if (const char* p = std::getenv("BSM_TUNING_FILE")) return p;
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.bsm_tuning";
+}
+
+/*******************************************
+ * @brief Looks up the tuning stored for this CPU model.
+ *
+ * File format: one "<key>\t<chunk> <threads>" line per model. Entries
+ * from older builds, which also stored an unroll factor, are skipped
+ * and the machine is tuned again.
+ *
+ * @param key CPU model key.
+ * @param t Output tuning.
+ * @return True if an entry was found.
+ *******************************************/
+static bool load_tuning(const std::string &key, kernel_tuning &t) {
+    std::ifstream f(tuning_path());
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(0, tab, key) != 0 || tab != key.size()) continue;
+        kernel_tuning v;
+        int extra;
+        if (std::sscanf(line.c_str() + tab + 1, "%d %d %d", &v.chunk, &v.threads, &extra) == 2
+            && v.chunk > 0 && v.chunk <= MAX_CHUNK && v.chunk % 4 == 0 && v.threads > 0) {
+            t = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*******************************************
+ * @brief Stores the tuning for this CPU model, keeping other entries.
+ *
+ * @param key CPU model key.
+ * @param t Tuning to store.
+ *******************************************/
+static void save_tuning(const std::string &key, const kernel_tuning &t) {
+    std::string path = tuning_path();
+    std::vector<std::string> keep;
+    {
+        std::ifstream f(path);
+        std::string line;
+        while (std::getline(f, line)) {
+            if (line.compare(0, key.size() + 1, key + "\t") != 0) keep.push_back(line);
+        }
+    }
+    std::string tmp = path + ".tmp";
+    std::ofstream o(tmp);
+    for (const std::string &l : keep) o << l << "\n";
+    o << key << "\t" << t.chunk << " " << t.threads << "\n";
+    o.close();
+    if (o) std::rename(tmp.c_str(), path.c_str());
+}
+
+/*******************************************
+ * @brief Measures the throughput of one tuning candidate.
+ *
+ * @param t Candidate.
+ * @return Paths per second (best of two trials).
+ *******************************************/
+static double bench_tuning(const kernel_tuning &t) {
+    const ui64 nSim = 1 << 15;
+    const ui64 nRuns = 4 * (ui64)t.threads;
+    kernel_tuning saved = g_tune;
+    g_tune = t;
+    double best = 0.0;
+    for (int trial = 0; trial < 2; trial++) {
+        double acc = 0.0;
+        double t0 = dml_micros();
+        #pragma omp parallel num_threads(t.threads) reduction(+:acc)
+        {
+            omp_set_num_threads(1); // Same shape as the run loop.
+            #pragma omp for schedule(static)
+            for (ui64 run = 0; run < nRuns; run++) {
+                acc += black_scholes_monte_carlo_fused_noreject(100.0, 110.0, 1.0, 0.06, 0.2, nSim, run);
+            }
+        }
+        double dt = (dml_micros() - t0) * 1e-6;
+        if (acc != acc) dt = 1e30; // keeps acc alive
+        best = std::max(best, double(nSim * nRuns) / dt);
+    }
+    g_tune = saved;
+    return best;
+}
+
+/*******************************************
+ * @brief Picks chunk size and thread count for this machine.
+ *
+ * The chunk is swept at full thread count, then the thread count is
+ * swept (halving) with the winning chunk.
+ *
+ * @return Best tuning found.
+ *******************************************/
+static kernel_tuning autotune() {
+    int maxThreads = omp_get_max_threads();
+    kernel_tuning best = {256, maxThreads};
+    double bestRate = 0.0;
+    for (int chunk = 64; chunk <= MAX_CHUNK; chunk *= 2) {
+        kernel_tuning t = {chunk, maxThreads};
+        double rate = bench_tuning(t);
+        if (rate > bestRate) { bestRate = rate; best = t; }
+    }
+    for (int th = maxThreads / 2; th >= 1 && th >= maxThreads / 8; th /= 2) {
+        kernel_tuning t = best;
+        t.threads = th;
+        double rate = bench_tuning(t);
+        if (rate > bestRate) { bestRate = rate; best = t; }
+    }
+    std::cout << std::scientific << std::setprecision(3)
+              << "Tuning: " << bestRate << " paths/s" << std::defaultfloat << std::endl;
+    return best;
+}
+
+/*******************************************
+ * @brief Checkpoint of a long run, as stored on disk.
+ *
+ * The kernel reseeds its generators from (thread, run index) at the
+ * start of every run, so the RNG state of any future run is a function
+ * of its index: the next run index and the partial sum are enough to
+ * resume exactly. The chunk size is saved too, since it fixes the
+ * summation grouping.
+ *******************************************/
+struct run_checkpoint {
+    char magic[8];
+    ui64 nSim;
+    ui64 nRuns;
+    ui64 nextRun;
+    double sumVal;
+    double elapsed;
+    int chunk;
+    int product;
+    int model;
+};
+
+#define CHECKPOINT_MAGIC "BSMCKPT4"
+
+/*******************************************
+ * @brief Writes a checkpoint atomically (temporary file, fsync, rename).
+ *
+ * @param path Checkpoint file.
+ * @param ck Checkpoint content.
+ *******************************************/
+static void write_checkpoint(const std::string &path, run_checkpoint ck) {
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    bool ok = std::fwrite(&ck, sizeof(ck), 1, f) == 1;
+    ok = (std::fflush(f) == 0) && ok;
+    ok = (fsync(fileno(f)) == 0) && ok;
+    std::fclose(f);
+    if (ok) std::rename(tmp.c_str(), path.c_str());
+}
+
+/*******************************************
+ * @brief Reads a checkpoint matching the current run configuration.
+ *
+ * @param path Checkpoint file.
+ * @param nSim Expected number of simulations.
+ * @param nRuns Expected number of runs.
+ * @param ck Output checkpoint.
+ * @return True if a usable checkpoint was found.
+ *******************************************/
+static bool read_checkpoint(const std::string &path, ui64 nSim, ui64 nRuns,
+                            run_checkpoint &ck) {
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    bool ok = std::fread(&ck, sizeof(ck), 1, f) == 1;
+    std::fclose(f);
+    return ok && std::memcmp(ck.magic, CHECKPOINT_MAGIC, 8) == 0
+        && ck.nSim == nSim && ck.nRuns == nRuns && ck.nextRun <= nRuns
+        && ck.chunk > 0 && ck.chunk <= MAX_CHUNK && ck.chunk % 4 == 0
+        && ck.product >= PRODUCT_CALL && ck.product <= PRODUCT_DIGITAL
+        && (ck.model == MODEL_APPROX_EXP || ck.model == MODEL_EXACT_EXP);
+}
+
+/*******************************************
+ * @brief Periodic reporter for long runs.
+ *
+ * Every interval it reads the per-thread counters and publishes the
+ * throughput, the per-thread progress and the running estimate with
+ * its 95% confidence interval: one line on stderr and, when a path is
+ * given, a Prometheus text file (written to a temporary file and
+ * renamed, so a textfile collector never reads a partial one). The
+ * workers never wait on it.
+ *******************************************/
+struct telemetry_sampler {
+    double interval = 0.0;      // seconds between samples
+    std::string promPath;       // Prometheus file, empty for stderr only
+    ui64 nSim = 0;
+    ui64 nRuns = 0;
+    ui64 firstRun = 0;          // runs restored from a checkpoint
+    double priorSum = 0.0;      // their sum
+
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool done = false;
+    double t0 = 0.0, tLast = 0.0;
+    ui64 lastPaths = 0;
+    std::vector<ui64> lastThreadPaths;
+
+    void start() {
+        t0 = tLast = dml_micros();
+        lastThreadPaths.assign(g_progress.size(), 0);
+        thread = std::thread([this] {
+            std::unique_lock<std::mutex> lk(lock);
+            while (!wake.wait_for(lk, std::chrono::duration<double>(interval),
+                                  [this] { return done; }))
+                sample();
+        });
+    }
+
+    void stop() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            done = true;
+        }
+        wake.notify_one();
+        thread.join();
+        sample();
+    }
+
+    void sample() {
+        const size_t n = g_progress.size();
+        std::vector<ui64> paths(n), runs(n);
+        ui64 totPaths = 0, totRuns = 0, minPaths = ~0ULL, maxPaths = 0;
+        double sum = 0.0, sumSq = 0.0;
+        int idle = 0;
+        for (size_t t = 0; t < n; t++) {
+            const thread_progress &p = g_progress[t];
+            paths[t] = p.paths.load(std::memory_order_relaxed);
+            runs[t] = p.runs.load(std::memory_order_relaxed);
+            sum += p.sum.load(std::memory_order_relaxed);
+            sumSq += p.sumSq.load(std::memory_order_relaxed);
+            totPaths += paths[t];
+            totRuns += runs[t];
+            minPaths = std::min(minPaths, paths[t]);
+            maxPaths = std::max(maxPaths, paths[t]);
+            if (paths[t] == lastThreadPaths[t]) idle++;
+        }
+
+        double now = dml_micros();
+        double elapsed = (now - t0) * 1e-6;
+        double dt = std::max((now - tLast) * 1e-6, 1e-9);
+        double rate = double(totPaths - lastPaths) / dt;
+        ui64 completed = firstRun + totRuns;
+        double estimate = completed ? (priorSum + sum) / double(completed) : 0.0;
+        double ci95 = 0.0;
+        if (totRuns > 1) {
+            // Spread of the run values seen by this process.
+            double m = sum / double(totRuns);
+            double var = std::max(sumSq / double(totRuns) - m * m, 0.0)
+                       * double(totRuns) / double(totRuns - 1);
+            ci95 = 1.96 * std::sqrt(var / double(completed));
+        }
+        double eta = rate > 0.0 ? double(nRuns - completed) * double(nSim) / rate : 0.0;
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1)
+             << "[telemetry] " << elapsed << " s   runs= " << completed << "/" << nRuns
+             << " (" << 100.0 * double(completed) / double(nRuns) << "%)"
+             << std::scientific << std::setprecision(3) << "   paths/s= " << rate
+             << std::fixed << std::setprecision(6)
+             << "   value= " << estimate << " +- " << ci95
+             << std::scientific << std::setprecision(2)
+             << "   thread paths min/max= " << double(minPaths) << "/" << double(maxPaths)
+             << "   idle= " << idle << "/" << n
+             << std::fixed << std::setprecision(0) << "   eta= " << eta << " s\n";
+        std::cerr << line.str() << std::flush;
+
+        if (!promPath.empty()) {
+            std::string tmp = promPath + ".tmp";
+            std::ofstream f(tmp);
+            f << std::setprecision(17)
+              << "# HELP bsm_paths_total Paths simulated by this process.\n"
+              << "# TYPE bsm_paths_total counter\n"
+              << "bsm_paths_total " << totPaths << "\n"
+              << "# HELP bsm_paths_per_second Throughput over the last sampling interval.\n"
+              << "# TYPE bsm_paths_per_second gauge\n"
+              << "bsm_paths_per_second " << rate << "\n"
+              << "# HELP bsm_runs_completed Runs completed, including restored ones.\n"
+              << "# TYPE bsm_runs_completed gauge\n"
+              << "bsm_runs_completed " << completed << "\n"
+              << "# HELP bsm_runs_requested Runs requested for this job.\n"
+              << "# TYPE bsm_runs_requested gauge\n"
+              << "bsm_runs_requested " << nRuns << "\n"
+              << "# HELP bsm_estimate Running mean of the completed runs.\n"
+              << "# TYPE bsm_estimate gauge\n"
+              << "bsm_estimate " << estimate << "\n"
+              << "# HELP bsm_estimate_ci95 Half-width of the 95% confidence interval.\n"
+              << "# TYPE bsm_estimate_ci95 gauge\n"
+              << "bsm_estimate_ci95 " << ci95 << "\n"
+              << "# HELP bsm_elapsed_seconds Time since the run loop started.\n"
+              << "# TYPE bsm_elapsed_seconds gauge\n"
+              << "bsm_elapsed_seconds " << elapsed << "\n"
+              << "# HELP bsm_thread_paths_total Paths simulated per worker.\n"
+              << "# TYPE bsm_thread_paths_total counter\n";
+            for (size_t t = 0; t < n; t++) {
+                f << "bsm_thread_paths_total{thread=\"" << t << "\",cpu=\""
+                  << (t < g_slots.size() ? g_slots[t].cpu : -1) << "\"} " << paths[t] << "\n";
+            }
+            f << "# HELP bsm_thread_runs_total Runs completed per worker.\n"
+              << "# TYPE bsm_thread_runs_total counter\n";
+            for (size_t t = 0; t < n; t++)
+                f << "bsm_thread_runs_total{thread=\"" << t << "\"} " << runs[t] << "\n";
+            f.close();
+            if (f) std::rename(tmp.c_str(), promPath.c_str());
+        }
+
+        tLast = now;
+        lastPaths = totPaths;
+        lastThreadPaths = paths;
+    }
+};
+
 /*******************************************
  * @brief Main function for Monte Carlo Black-Scholes simulation.
  *
@@ -176,13 +731,53 @@ double black_scholes_monte_carlo_fused_noreject(
  *******************************************/
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <num_sims> <num_runs>\n";
+        std::cerr << "Usage: " << argv[0] << " <num_sims> <num_runs>"
+                  << " [--checkpoint <file>] [--checkpoint-every <runs>] [--restart]"
+                  << " [--no-pin] [--hugepages] [--tune | --no-tune]"
+                  << " [--product call|put|digital] [--model approx|exact]"
+                  << " [--telemetry <seconds>] [--metrics <file.prom>]\n";
         return 1;
     }
 
     ui64 nSim = std::stoull(argv[1]);
     ui64 nRuns = std::stoull(argv[2]);
 
+    std::string ckPath;
+    ui64 ckEvery = 0;
+    bool restart = false;
+    bool pin = true;
+    int tuneMode = 0; // -1: defaults, 0: cached or tune once, 1: always tune
+    telemetry_sampler telemetry;
+    for (int a = 3; a < argc; a++) {
+        std::string opt = argv[a];
+        if (opt == "--checkpoint" && a + 1 < argc) ckPath = argv[++a];
+        else if (opt == "--checkpoint-every" && a + 1 < argc) ckEvery = std::stoull(argv[++a]);
+        else if (opt == "--restart") restart = true;
+        else if (opt == "--no-pin") pin = false;
+        else if (opt == "--hugepages") g_hugepages = true;
+        else if (opt == "--tune") tuneMode = 1;
+        else if (opt == "--no-tune") tuneMode = -1;
+        else if (opt == "--telemetry" && a + 1 < argc) telemetry.interval = std::stod(argv[++a]);
+        else if (opt == "--metrics" && a + 1 < argc) telemetry.promPath = argv[++a];
+        else if (opt == "--product" && a + 1 < argc) {
+            std::string v = argv[++a];
+            if (v == "call") g_product = PRODUCT_CALL;
+            else if (v == "put") g_product = PRODUCT_PUT;
+            else if (v == "digital") g_product = PRODUCT_DIGITAL;
+            else { std::cerr << "Unknown product " << v << "\n"; return 1; }
+        }
+        else if (opt == "--model" && a + 1 < argc) {
+            std::string v = argv[++a];
+            if (v == "approx") g_model = MODEL_APPROX_EXP;
+            else if (v == "exact") g_model = MODEL_EXACT_EXP;
+            else { std::cerr << "Unknown model " << v << "\n"; return 1; }
+        }
+        else {
+            std::cerr << "Unknown option " << opt << "\n";
+            return 1;
+        }
+    }
+
     double S0 = 100.0;
     double K = 110.0;
     double T = 1.0;
@@ -194,26 +789,129 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Global initial seed: " << global_seed
               << "   argv[1]= " << argv[1]
-              << "   argv[2]= " << argv[2] << std::endl;
+              << "   argv[2]= " << argv[2]
+              << "   product= " << PRODUCT_NAMES[g_product]
+              << "   model= " << MODEL_NAMES[g_model] << std::endl;
 
-    double t1 = dml_micros();
+    setup_thread_slots(pin);
+
+    g_tune.threads = omp_get_max_threads();
+    if (tuneMode >= 0) {
+        std::string key = cpu_model_key();
+        if (tuneMode == 1 || !load_tuning(key, g_tune)) {
+            if (tuneMode == 0)
+                std::cout << "No tuning stored for " << key << ", tuning now"
+                          << " (--no-tune uses the defaults)" << std::endl;
+            g_tune = autotune();
+            save_tuning(key, g_tune);
+        }
+        g_tune.threads = std::min(g_tune.threads, omp_get_max_threads());
+    }
+
+    // Runs are processed in epochs; per-run values are summed in run order
+    // so the result does not depend on thread scheduling or on restarts.
+    ui64 epoch = ckEvery ? ckEvery
+                         : std::max<ui64>(nRuns / 100, 4 * (ui64)g_tune.threads);
 
+    ui64 firstRun = 0;
     double sumVal = 0.0;
-    #pragma omp parallel for reduction(+:sumVal)
-    for (ui64 run = 0; run < nRuns; run++) {
-        sumVal += black_scholes_monte_carlo_fused_noreject(
-            S0, K, T, r, sigma, nSim, run
-        );
+    double priorElapsed = 0.0;
+    if (restart) {
+        run_checkpoint ck;
+        if (ckPath.empty() || !read_checkpoint(ckPath, nSim, nRuns, ck)) {
+            std::cerr << "No usable checkpoint to restart from\n";
+            return 1;
+        }
+        firstRun = ck.nextRun;
+        sumVal = ck.sumVal;
+        priorElapsed = ck.elapsed;
+        if (ck.product != g_product || ck.model != g_model) {
+            std::cerr << "Checkpoint was written for product " << PRODUCT_NAMES[ck.product]
+                      << ", model " << MODEL_NAMES[ck.model] << "\n";
+            return 1;
+        }
+        g_tune.chunk = ck.chunk;
+        std::cout << "Restarting at run " << firstRun << " / " << nRuns << std::endl;
+    }
+
+    std::cout << "Tuning: chunk= " << g_tune.chunk
+              << "   threads= " << g_tune.threads << std::endl;
+
+    std::vector<double> runVal(std::min(epoch, nRuns));
+    std::thread ckWriter;
+
+    if (telemetry.interval <= 0.0 && !telemetry.promPath.empty()) telemetry.interval = 10.0;
+    if (telemetry.interval > 0.0) {
+        g_progress = std::vector<thread_progress>(g_tune.threads);
+        telemetry.nSim = nSim;
+        telemetry.nRuns = nRuns;
+        telemetry.firstRun = firstRun;
+        telemetry.priorSum = sumVal;
+        telemetry.start();
     }
 
+    double t1 = dml_micros();
+
+    for (ui64 base = firstRun; base < nRuns; base += epoch) {
+        ui64 cnt = std::min(epoch, nRuns - base);
+
+        #pragma omp parallel num_threads(g_tune.threads)
+        {
+            thread_progress *progress =
+                g_progress.empty() ? nullptr : &g_progress[omp_get_thread_num()];
+            tl_progress = progress;
+            // Each run on one thread. The kernel seeds per thread, so a run
+            // forking its own team (threads= 1 leaves this region inactive)
+            // would change its value with the tuning.
+            omp_set_num_threads(1);
+
+            #pragma omp for schedule(static)
+            for (ui64 i = 0; i < cnt; i++) {
+                double v = black_scholes_monte_carlo_fused_noreject(
+                    S0, K, T, r, sigma, nSim, base + i
+                );
+                runVal[i] = v;
+                if (progress) {
+                    // Single writer: plain load/store, no read-modify-write.
+                    auto &p = *progress;
+                    p.runs.store(p.runs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    p.sum.store(p.sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+                    p.sumSq.store(p.sumSq.load(std::memory_order_relaxed) + v * v, std::memory_order_relaxed);
+                }
+            }
+
+            tl_progress = nullptr;
+        }
+        for (ui64 i = 0; i < cnt; i++) sumVal += runVal[i];
+
+        if (!ckPath.empty()) {
+            run_checkpoint ck;
+            std::memcpy(ck.magic, CHECKPOINT_MAGIC, 8);
+            ck.nSim = nSim;
+            ck.nRuns = nRuns;
+            ck.nextRun = base + cnt;
+            ck.sumVal = sumVal;
+            ck.elapsed = priorElapsed + (dml_micros() - t1) * 1e-6;
+            ck.chunk = g_tune.chunk;
+            ck.product = g_product;
+            ck.model = g_model;
+            // The previous write is long done by the time an epoch ends.
+            if (ckWriter.joinable()) ckWriter.join();
+            ckWriter = std::thread(write_checkpoint, ckPath, ck);
+        }
+    }
+    if (ckWriter.joinable()) ckWriter.join();
+
     double t2 = dml_micros();
+    telemetry.stop();
     double meanVal = sumVal / double(nRuns);
     double elapsed = (t2 - t1) * 1e-6;
 
     std::cout << std::fixed << std::setprecision(6)
               << "value= " << meanVal
-              << " in " << elapsed << " s\n";
+              << " in " << elapsed << " s";
+    if (restart) std::cout << " (" << priorElapsed + elapsed << " s including previous attempts)";
+    std::cout << "\n";
 
     return 0;
 }
-
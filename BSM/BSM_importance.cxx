@@ -0,0 +1,269 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Importance sampling for out-of-the-money calls and digitals.
+
+    Usage: ./BSM_importance <num_sims> <call|digital> [K] [analytic|pilot]
+
+    The terminal Gaussian is drawn from N(theta, 1) instead of N(0, 1) and
+    each payoff is multiplied by the likelihood ratio
+    exp(-theta * Z + theta^2 / 2), computed in the same SIMD loop.
+
+    theta is chosen
+        analytic: at the mode of payoff * density (saddle point for the
+                  call, the strike for the digital);
+        pilot:    by a short pilot run started from the analytic value,
+                  Newton steps on the sampled second moment of the
+                  weighted payoff.
+
+    Both plain and importance-sampled estimates are printed with their
+    standard errors, the variance ratio (= path reduction factor at equal
+    accuracy) and the effective sample size (sum w)^2 / sum w^2. The ratio
+    is "n/a" when the plain run had no paying path (its variance is then
+    zero, not small), and an ESS below ESS_MIN paths is flagged as
+    unreliable: a handful of weights carry the whole estimate.
+*/
+
+#define CHUNK 256
+#define PILOT_SIMS (1 << 14)
+#define ESS_MIN 100.0
+
+enum payoff_kind { CALL, DIGITAL };
+
+/*******************************************
+ * @brief Contract parameters.
+ *******************************************/
+struct is_params {
+    double S0, K, T, r, sigma;
+    int payoff;
+};
+
+/*******************************************
+ * @brief Sums returned by the kernel.
+ *******************************************/
+struct is_sums {
+    double sumF, sumF2;   // weighted payoff and its square
+    double sumW, sumW2;   // likelihood ratios
+    ui64 nonZero;         // paths with a non-zero payoff
+};
+
+/*******************************************
+ * @brief Importance-sampled Monte Carlo kernel.
+ *
+ * theta = 0 gives plain Monte Carlo with the same random numbers.
+ *
+ * @param p Contract.
+ * @param theta Mean shift of the terminal Gaussian.
+ * @param nSim Number of paths (rounded up to CHUNK).
+ * @param seed Base seed.
+ * @return Sums of weighted payoffs and weights.
+ *******************************************/
+static is_sums is_kernel(const is_params &p, double theta, ui64 nSim, ui64 seed) {
+    const double drift = (p.r - 0.5 * p.sigma * p.sigma) * p.T;
+    const double vol = p.sigma * std::sqrt(p.T);
+    const double half = 0.5 * theta * theta;
+    const ui64 nBlocks = (nSim + CHUNK - 1) / CHUNK;
+
+    double sF = 0.0, sF2 = 0.0, sW = 0.0, sW2 = 0.0;
+    ui64 nz = 0;
+
+    #pragma omp parallel reduction(+:sF, sF2, sW, sW2, nz)
+    {
+        alignas(64) double g[CHUNK];
+
+        #pragma omp for schedule(static)
+        for (ui64 b = 0; b < nBlocks; b++) {
+            xorshift128plus_state rng;
+            xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0xA5ULL * (seed + 1)) ^ (0x9E37ULL * (b + 1))));
+            normal_block(rng, g, CHUNK);
+
+            double f1 = 0.0, f2 = 0.0, w1 = 0.0, w2 = 0.0;
+            ui64 cnt = 0;
+            #pragma omp simd reduction(+:f1, f2, w1, w2, cnt)
+            for (int i = 0; i < CHUNK; i++) {
+                double z = g[i] + theta;
+                double w = std::exp(half - theta * z);
+                double ST = p.S0 * std::exp(drift + vol * z);
+                double pay = (p.payoff == CALL) ? std::max(ST - p.K, 0.0)
+                                                : (ST > p.K ? 1.0 : 0.0);
+                double f = pay * w;
+                f1 += f;
+                f2 += f * f;
+                w1 += w;
+                w2 += w * w;
+                cnt += pay > 0.0 ? 1 : 0;
+            }
+            sF += f1;
+            sF2 += f2;
+            sW += w1;
+            sW2 += w2;
+            nz += cnt;
+        }
+    }
+    return {sF, sF2, sW, sW2, nz};
+}
+
+/*******************************************
+ * @brief Analytic mean shift.
+ *
+ * Call: maximizes log(S_T(z) - K) - z^2 / 2, i.e. solves
+ * vol * S_T / (S_T - K) = z (Newton from above the strike).
+ * Digital: the strike point z_K, if out of the money.
+ *
+ * @param p Contract.
+ * @return Shift theta.
+ *******************************************/
+static double analytic_theta(const is_params &p) {
+    const double drift = (p.r - 0.5 * p.sigma * p.sigma) * p.T;
+    const double vol = p.sigma * std::sqrt(p.T);
+    const double zK = (std::log(p.K / p.S0) - drift) / vol;
+    if (p.payoff == DIGITAL) return std::max(zK, 0.0);
+
+    // h(z) = vol * e / (e - K) - z, decreasing for z > zK.
+    double z = std::max(zK, 0.0) + 1.0;
+    for (int it = 0; it < 50; it++) {
+        double e = p.S0 * std::exp(drift + vol * z);
+        double h = vol * e / (e - p.K) - z;
+        double dh = -vol * vol * e * p.K / ((e - p.K) * (e - p.K)) - 1.0;
+        double step = h / dh;
+        z = std::max(z - step, 0.5 * (z + zK)); // stay above the strike
+        if (std::fabs(step) < 1e-12) break;
+    }
+    return z;
+}
+
+/*******************************************
+ * @brief Refines the shift with a pilot run.
+ *
+ * With pilot draws Z ~ N(theta0, 1) and f = payoff, the second moment
+ * under shift theta is
+ *     m(theta) = E0[f^2 exp(theta^2/2 - theta Z) exp(theta0^2/2 - theta0 Z)],
+ * convex in theta; a few Newton steps minimize it.
+ *
+ * @param p Contract.
+ * @param theta0 Starting shift.
+ * @return Refined shift.
+ *******************************************/
+static double pilot_theta(const is_params &p, double theta0) {
+    const double drift = (p.r - 0.5 * p.sigma * p.sigma) * p.T;
+    const double vol = p.sigma * std::sqrt(p.T);
+    alignas(64) double g[CHUNK];
+    static double z[PILOT_SIMS], c[PILOT_SIMS];
+
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, 0x5EED5EEDULL);
+    int n = 0;
+    for (int b = 0; b < PILOT_SIMS / CHUNK; b++) {
+        normal_block(rng, g, CHUNK);
+        for (int i = 0; i < CHUNK; i++) {
+            double zi = g[i] + theta0;
+            double ST = p.S0 * std::exp(drift + vol * zi);
+            double pay = (p.payoff == CALL) ? std::max(ST - p.K, 0.0) : (ST > p.K ? 1.0 : 0.0);
+            if (pay <= 0.0) continue;
+            z[n] = zi;
+            c[n] = pay * pay * std::exp(0.5 * theta0 * theta0 - theta0 * zi);
+            n++;
+        }
+    }
+    if (n < 16) return theta0;
+
+    double theta = theta0;
+    for (int it = 0; it < 20; it++) {
+        double d1 = 0.0, d2 = 0.0;
+        for (int i = 0; i < n; i++) {
+            double e = c[i] * std::exp(0.5 * theta * theta - theta * z[i]);
+            double u = theta - z[i];
+            d1 += e * u;
+            d2 += e * (1.0 + u * u);
+        }
+        double step = d1 / d2;
+        theta -= step;
+        if (std::fabs(step) < 1e-10) break;
+    }
+    return theta;
+}
+
+/*******************************************
+ * @brief Closed-form price of the contract.
+ *******************************************/
+static double closed_form(const is_params &p) {
+    if (p.payoff == CALL) return bsm_price(p.S0, p.K, p.T, p.r, 0.0, p.sigma, 1);
+    double sq = p.sigma * std::sqrt(p.T);
+    double d2 = (std::log(p.S0 / p.K) + (p.r - 0.5 * p.sigma * p.sigma) * p.T) / sq;
+    return std::exp(-p.r * p.T) * norm_cdf(d2);
+}
+
+/*******************************************
+ * @brief Main function: plain vs importance-sampled estimates.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <num_sims> <call|digital> [K] [analytic|pilot]\n";
+        return 1;
+    }
+    ui64 nSim = std::stoull(argv[1]);
+    std::string kind = argv[2];
+    is_params p = {100.0, 110.0, 1.0, 0.06, 0.2, kind == "digital" ? DIGITAL : CALL};
+    if (kind != "call" && kind != "digital") {
+        std::cerr << "Unknown payoff " << kind << "\n";
+        return 1;
+    }
+    if (argc > 3) p.K = std::atof(argv[3]);
+    std::string mode = (argc > 4) ? argv[4] : "pilot";
+    if (mode != "analytic" && mode != "pilot") {
+        std::cerr << "Unknown mode " << mode << "\n";
+        return 1;
+    }
+
+    double disc = std::exp(-p.r * p.T);
+    double N = double((nSim + CHUNK - 1) / CHUNK * CHUNK);
+
+    is_sums plain = is_kernel(p, 0.0, nSim, 1);
+    double mP = plain.sumF / N;
+    double vP = std::max(plain.sumF2 / N - mP * mP, 0.0);
+
+    double t1 = dml_micros();
+    double theta = analytic_theta(p);
+    if (mode == "pilot") theta = pilot_theta(p, theta);
+    is_sums s = is_kernel(p, theta, nSim, 1);
+    double t2 = dml_micros();
+
+    double m = s.sumF / N;
+    double v = std::max(s.sumF2 / N - m * m, 0.0);
+    double ess = s.sumW * s.sumW / s.sumW2;
+
+    std::cout << std::fixed << std::setprecision(6)
+              << "payoff= " << kind << "   K= " << p.K << "   closed form= " << closed_form(p) << "\n"
+              << "plain:      " << disc * mP << " +- " << disc * std::sqrt(vP / N)
+              << "   non-zero paths= " << std::setprecision(2) << 100.0 * plain.nonZero / N << "%\n"
+              << std::setprecision(6)
+              << "importance: " << disc * m << " +- " << disc * std::sqrt(v / N)
+              << "   non-zero paths= " << std::setprecision(2) << 100.0 * s.nonZero / N << "%\n"
+              << std::setprecision(4)
+              << "theta= " << theta << " (" << mode << ")   variance ratio= ";
+    if (plain.nonZero == 0) std::cout << "n/a (no plain hits)";
+    else if (s.nonZero == 0) std::cout << "n/a (no importance hits)";
+    else std::cout << (v > 0.0 ? vP / v : 0.0);
+    std::cout << "   ESS= " << std::setprecision(0) << ess
+              << " (" << std::setprecision(2) << 100.0 * ess / N << "%)";
+    if (!(ess >= ESS_MIN)) std::cout << "   unreliable: ESS < " << std::setprecision(0) << ESS_MIN;
+    std::cout << "\n";
+
+    std::cout << std::fixed << std::setprecision(6)
+              << "value= " << disc * m << " in " << (t2 - t1) * 1e-6 << " s\n";
+    return 0;
+}
@@ -0,0 +1,472 @@
+/*
+    Pricing kernels shared by the programs that ship them and by the
+    programs that check them (BSM_accuracy, the bsm Python module), so a
+    check always runs the code the benchmarks run, plus the helpers every
+    engine uses.
+
+        all engines    dml_micros, xorshift128+, uniform01, seed_mix,
+                       box_muller_pair / normal_block, norm_cdf / norm_pdf,
+                       bsm_price (closed form with dividend yield)
+        BSM_final      box_muller_no_reject, exp_approx_clamp,
+                       payoff / model / RNG policies and block_payoff_sum
+        BSM_mpi        gaussian_box_muller(_seed), approx_sqrt, approx_exp and
+                       black_scholes_monte_carlo_unroll_mpi_approx
+        BSM_SVE        sve_exp_approx, sve_payoff (SVE builds only)
+        BSM_assembly   sve_exp_asm (AArch64 builds only)
+*/
+
+#ifndef BSM_KERNELS_H
+#define BSM_KERNELS_H
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <sys/time.h>
+#if defined(__ARM_FEATURE_SVE)
+#include <arm_sve.h>
+#endif
+
+#define ui64 uint64_t
+
+/*******************************************
+ * @brief Returns the current time in microseconds.
+ *
+ * @return Current time in microseconds.
+ *******************************************/
+static inline double dml_micros() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return double(tv.tv_sec) * 1e6 + double(tv.tv_usec);
+}
+
+/*******************************************
+ * @brief XORSHIFT128+ pseudo-random number generator initialization.
+ *
+ * @param st XORSHIFT state.
+ * @param seed Initial seed.
+ *******************************************/
+struct xorshift128plus_state {
+    ui64 s[2];
+};
+
+static inline void xorshift128plus_init(xorshift128plus_state &st, ui64 seed) {
+    st.s[0] = seed;
+    st.s[1] = seed ^ 0x9E3779B97F4A7C15ULL;
+}
+
+/*******************************************
+ * @brief XORSHIFT128+ pseudo-random number generator.
+ *
+ * @param st XORSHIFT state.
+ * @return Random 64-bit unsigned integer.
+ *******************************************/
+static inline ui64 xorshift128plus(xorshift128plus_state &st) {
+    ui64 x = st.s[0];
+    ui64 y = st.s[1];
+    st.s[0] = y;
+    x ^= x << 23;
+    x ^= x >> 17;
+    x ^= y ^ (y >> 26);
+    st.s[1] = x;
+    return x + y;
+}
+
+/*******************************************
+ * @brief Uniform double in [0, 1) from the top of one draw.
+ *
+ * @param st XORSHIFT state.
+ * @return Uniform random variable.
+ *******************************************/
+static inline double uniform01(xorshift128plus_state &st) {
+    return double(xorshift128plus(st)) * (1.0 / 18446744073709551616.0);
+}
+
+/*******************************************
+ * @brief SplitMix64 finalizer, turns nearby seeds into unrelated states.
+ *******************************************/
+static inline ui64 seed_mix(ui64 z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*******************************************
+ * @brief Box-Muller transform keeping both outputs.
+ *
+ * @param u1 Uniform random variable in [0, 1).
+ * @param u2 Uniform random variable in [0, 1).
+ * @param g1 First standard normal (output).
+ * @param g2 Second standard normal (output).
+ *******************************************/
+static inline void box_muller_pair(double u1, double u2, double &g1, double &g2) {
+    if (u1 < 1e-16) u1 = 1e-16; // Clamp to avoid log(0)
+    double rad = std::sqrt(-2.0 * std::log(u1));
+    g1 = rad * std::cos(2.0 * M_PI * u2);
+    g2 = rad * std::sin(2.0 * M_PI * u2);
+}
+
+/*******************************************
+ * @brief Fills a block with standard normals, two per pair of uniforms.
+ *
+ * An odd n is rounded up: g must hold n + 1 values.
+ *
+ * @param st XORSHIFT state.
+ * @param g Output normals.
+ * @param n Number of normals.
+ *******************************************/
+static inline void normal_block(xorshift128plus_state &st, double *g, int n) {
+    for (int i = 0; i < n; i += 2) {
+        double u1 = uniform01(st);
+        double u2 = uniform01(st);
+        box_muller_pair(u1, u2, g[i], g[i + 1]);
+    }
+}
+
+/*******************************************
+ * @brief Box-Muller transform without rejection.
+ *
+ * @param u1 Uniform random variable in [0, 1).
+ * @param u2 Uniform random variable in [0, 1).
+ * @return Standard normal random variable.
+ *******************************************/
+__attribute__((always_inline)) static inline double box_muller_no_reject(double u1, double u2) {
+    if (u1 < 1e-16) u1 = 1e-16; // Clamp to avoid log(0)
+    double r = std::sqrt(-2.0 * std::log(u1));
+    double theta = 2.0 * M_PI * u2;
+    return r * std::cos(theta);
+}
+
+/*******************************************
+ * @brief Approximates exponential with clamping.
+ *
+ * @param x Input value.
+ * @return Approximated exponential value.
+ *******************************************/
+__attribute__((always_inline)) static inline double exp_approx_clamp(double x) {
+    if (x < -10.0) x = -10.0;
+    else if (x > 10.0) x = 10.0;
+    double x2 = x * x;
+    double x3 = x2 * x;
+    return 1.0 + x + 0.5 * x2 + (1.0 / 6.0) * x3;
+}
+
+/*******************************************
+ * @brief Standard normal cumulative distribution function.
+ *******************************************/
+static inline double norm_cdf(double x) {
+    return 0.5 * std::erfc(-x * M_SQRT1_2);
+}
+
+/*******************************************
+ * @brief Standard normal density.
+ *******************************************/
+static inline double norm_pdf(double x) {
+    return 0.3989422804014327 * std::exp(-0.5 * x * x);
+}
+
+/*******************************************
+ * @brief Closed-form Black-Scholes-Merton price.
+ *
+ * @param S0 Initial stock price.
+ * @param K Strike price.
+ * @param T Time to maturity.
+ * @param r Risk-free interest rate.
+ * @param q Dividend yield.
+ * @param sigma Volatility.
+ * @param isCall 1 for a call, 0 for a put.
+ * @return Option price.
+ *******************************************/
+static inline double bsm_price(double S0, double K, double T, double r, double q,
+                               double sigma, int isCall) {
+    double sq = sigma * std::sqrt(T);
+    double d1 = (std::log(S0 / K) + (r - q + 0.5 * sigma * sigma) * T) / sq;
+    double d2 = d1 - sq;
+    double w = isCall ? 1.0 : -1.0; // Branch free, so it vectorizes.
+    return w * (S0 * std::exp(-q * T) * norm_cdf(w * d1) - K * std::exp(-r * T) * norm_cdf(w * d2));
+}
+
+/*******************************************
+ * @brief Payoff policies: branch-free, inlined into the SIMD loop.
+ *******************************************/
+struct call_payoff {
+    __attribute__((always_inline)) static inline double eval(double ST, double K) {
+        return (ST > K) ? (ST - K) : 0.0;
+    }
+};
+
+struct put_payoff {
+    __attribute__((always_inline)) static inline double eval(double ST, double K) {
+        return (K > ST) ? (K - ST) : 0.0;
+    }
+};
+
+// Cash-or-nothing: pays 1 above the strike.
+struct digital_payoff {
+    __attribute__((always_inline)) static inline double eval(double ST, double K) {
+        return (ST > K) ? 1.0 : 0.0;
+    }
+};
+
+/*******************************************
+ * @brief Model policies: terminal price from one standard normal.
+ *
+ * Constructed once per kernel call; the SIMD loop only calls terminal().
+ *******************************************/
+struct approx_gbm_model {
+    double S0, drift, vol;
+
+    approx_gbm_model(double S0_, double T, double r, double sigma)
+        : S0(S0_), drift((r - 0.5 * sigma * sigma) * T), vol(sigma * std::sqrt(T)) {}
+
+    __attribute__((always_inline)) inline double terminal(double g) const {
+        return S0 * exp_approx_clamp(drift + vol * g);
+    }
+};
+
+struct exact_gbm_model {
+    double S0, drift, vol;
+
+    exact_gbm_model(double S0_, double T, double r, double sigma)
+        : S0(S0_), drift((r - 0.5 * sigma * sigma) * T), vol(sigma * std::sqrt(T)) {}
+
+    __attribute__((always_inline)) inline double terminal(double g) const {
+        return S0 * std::exp(drift + vol * g);
+    }
+};
+
+/*******************************************
+ * @brief RNG policy: xorshift128+ uniforms in [0, 1).
+ *******************************************/
+struct xorshift_uniform_rng {
+    xorshift128plus_state st;
+
+    void seed(ui64 s) { xorshift128plus_init(st, s); }
+
+    __attribute__((always_inline)) inline double next() {
+        return double(xorshift128plus(st)) * (1.0 / 18446744073709551616.0);
+    }
+};
+
+/*******************************************
+ * @brief Sum of payoffs over one block of uniform pairs.
+ *
+ * The single SIMD loop shared by every product and model.
+ *
+ * @param m Model.
+ * @param K Strike price.
+ * @param u1 First uniforms.
+ * @param u2 Second uniforms.
+ * @param n Number of paths.
+ * @return Undiscounted payoff sum.
+ *******************************************/
+template <class Payoff, class Model>
+__attribute__((always_inline)) static inline double block_payoff_sum(
+    const Model &m, double K, const double *u1, const double *u2, int n) {
+    double local = 0.0;
+    #pragma omp simd reduction(+:local)
+    for (int i = 0; i < n; i++) {
+        double g = box_muller_no_reject(u1[i], u2[i]);
+        local += Payoff::eval(m.terminal(g), K);
+    }
+    return local;
+}
+
+/*******************************************
+ * @brief Per-thread generator behind gaussian_box_muller().
+ *
+ * Seeded from std::random_device unless gaussian_box_muller_seed() is
+ * called on the thread.
+ *******************************************/
+struct gaussian_stream {
+    std::mt19937 generator{std::random_device{}()};
+    std::normal_distribution<double> distribution{0.0, 1.0};
+};
+
+inline gaussian_stream &gaussian_thread_stream() {
+    static thread_local gaussian_stream stream;
+    return stream;
+}
+
+/*******************************************
+ * @brief Generates Gaussian noise using the Box-Muller transform.
+ *
+ * @return Random Gaussian value.
+ *******************************************/
+inline double gaussian_box_muller() {
+    gaussian_stream &s = gaussian_thread_stream();
+    return s.distribution(s.generator);
+}
+
+/*******************************************
+ * @brief Reseeds the calling thread's gaussian_box_muller() stream.
+ *
+ * Also drops the spare normal cached by the distribution, so the draws
+ * that follow only depend on the seed.
+ *
+ * @param seed Generator seed.
+ *******************************************/
+inline void gaussian_box_muller_seed(ui64 seed) {
+    gaussian_stream &s = gaussian_thread_stream();
+    std::seed_seq seq{uint32_t(seed), uint32_t(seed >> 32)};
+    s.generator.seed(seq);
+    s.distribution.reset();
+}
+
+/*******************************************
+ * @brief Approximates the square root using one iteration of Newton's method.
+ *
+ * @param x Input value.
+ * @return Approximated square root.
+ *******************************************/
+inline double approx_sqrt(double x) {
+    double guess = x * 0.5;
+    guess = 0.5 * (guess + x / guess);
+    return guess;
+}
+
+/*******************************************
+ * @brief Approximates the exponential function using a truncated Taylor series.
+ *
+ * @param x Input value.
+ * @return Approximated exponential value.
+ *******************************************/
+inline double approx_exp(double x) {
+    if (x >  4.0) x =  4.0;
+    if (x < -4.0) x = -4.0;
+    double xx = x * x;
+    double term1 = 1.0 + x;
+    double term2 = 0.5 * xx;
+    double term3 = (xx * x) / 6.0;
+    return term1 + term2 + term3;
+}
+
+/*******************************************
+ * @brief Computes the Black-Scholes call option price using the Monte Carlo method.
+ *        This version uses loop unrolling, MPI for parallelization, and approximations.
+ *
+ * @param S0 Initial stock price.
+ * @param K Strike price.
+ * @param T Time to maturity.
+ * @param r Risk-free interest rate.
+ * @param sigma Volatility.
+ * @param q Dividend yield.
+ * @param local_num_sims Number of simulations for the local MPI process.
+ * @return Discounted sum of payoffs from the simulations.
+ *******************************************/
+inline double black_scholes_monte_carlo_unroll_mpi_approx(
+    ui64 S0, ui64 K, double T, double r, double sigma, double q,
+    ui64 local_num_sims)
+{
+    double drift    = (r - q - 0.5 * sigma * sigma) * T;
+    double vol      = sigma * approx_sqrt(T);
+    double discount = approx_exp(-r * T);
+
+    double sum_payoffs_local = 0.0;
+
+    ui64 main_loop = (local_num_sims / 4) * 4;
+    for (ui64 i = 0; i < main_loop; i += 4) {
+        double Z0 = gaussian_box_muller();
+        double Z1 = gaussian_box_muller();
+        double Z2 = gaussian_box_muller();
+        double Z3 = gaussian_box_muller();
+
+        double ST0 = S0 * approx_exp(drift + vol * Z0);
+        double ST1 = S0 * approx_exp(drift + vol * Z1);
+        double ST2 = S0 * approx_exp(drift + vol * Z2);
+        double ST3 = S0 * approx_exp(drift + vol * Z3);
+
+        sum_payoffs_local += ((ST0 > K) ? (ST0 - K) : 0.0)
+                           + ((ST1 > K) ? (ST1 - K) : 0.0)
+                           + ((ST2 > K) ? (ST2 - K) : 0.0)
+                           + ((ST3 > K) ? (ST3 - K) : 0.0);
+    }
+    for (ui64 i = main_loop; i < local_num_sims; i++) {
+        double Z = gaussian_box_muller();
+        double ST = S0 * approx_exp(drift + vol * Z);
+        sum_payoffs_local += (ST > K) ? (ST - K) : 0.0;
+    }
+
+    return discount * sum_payoffs_local;
+}
+
+#if defined(__ARM_FEATURE_SVE)
+
+/*******************************************
+ * @brief Approximates the exponential function using SVE intrinsics.
+ *
+ * The approximation uses a truncated Taylor series.
+ * @param x Input vector of values.
+ * @return Approximated exponential values for the input vector.
+ *******************************************/
+static inline svfloat64_t sve_exp_approx(svfloat64_t x)
+{
+    svbool_t pg = svptrue_b64(); // Active predicate for all lanes.
+    svfloat64_t mn = svdup_f64(-10.0); // Minimum clamp value.
+    svfloat64_t mx = svdup_f64(10.0);  // Maximum clamp value.
+    x = svmax_f64_m(pg, x, mn); // Clamp to minimum.
+    x = svmin_f64_m(pg, x, mx); // Clamp to maximum.
+
+    // Polynomial approximation: e^x ~ 1 + x + x^2/2 + x^3/6
+    svfloat64_t one = svdup_f64(1.0);
+    svfloat64_t x2 = svmul_f64_m(pg, x, x); // x^2
+    svfloat64_t x3 = svmul_f64_m(pg, x2, x); // x^3
+
+    svfloat64_t c2 = svmul_f64_m(pg, x2, svdup_f64(0.5));
+    svfloat64_t c3 = svmul_f64_m(pg, x3, svdup_f64(1.0 / 6.0));
+
+    svfloat64_t s = svadd_f64_m(pg, one, x);
+    s = svadd_f64_m(pg, s, c2);
+    s = svadd_f64_m(pg, s, c3);
+    return s;
+}
+
+/*******************************************
+ * @brief Calculates the payoff for a European call option.
+ *
+ * The payoff is max(ST - K, 0).
+ * @param st Vector of terminal stock prices.
+ * @param K Strike price.
+ * @param pg Predicate for active lanes.
+ * @return Vector of payoffs.
+ *******************************************/
+static inline svfloat64_t sve_payoff(
+    svfloat64_t st, svfloat64_t K, svbool_t pg)
+{
+    svfloat64_t diff = svsub_f64_m(pg, st, K); // ST - K
+    svbool_t mpos = svcmpgt_f64(pg, diff, svdup_f64(0.0)); // diff > 0
+    svfloat64_t pay = svsel_f64(mpos, diff, svdup_f64(0.0)); // Select positive values.
+    return pay;
+}
+
+#endif // __ARM_FEATURE_SVE
+
+#if defined(__aarch64__)
+
+/*******************************************
+ * @brief Approximates the exponential function using inline assembly.
+ *
+ * Implements the approximation e^x ≈ 1 + x + x^2/2 + x^3/6.
+ * @param x The input value.
+ * @return Approximated exponential value.
+ *******************************************/
+static inline double sve_exp_asm(double x) {
+    const double c1 = 1.0, c05 = 0.5, c166 = 1.0 / 6.0; // Taylor coefficients.
+    double res; // Result variable.
+    asm volatile(
+        " fmov d0, %1        \n" // Move input x into register d0.
+        " fmul d1, d0, d0    \n" // Compute x^2 in d1.
+        " fmul d2, d1, d0    \n" // Compute x^3 in d2.
+        " fadd d3, %2, d0    \n" // d3 = c1 + x.
+        " fmadd d3, d1, %3, d3 \n" // d3 += x^2 * c05.
+        " fmadd d3, d2, %4, d3 \n" // d3 += x^3 * c166.
+        " fmov %0, d3        \n" // Move result from d3 to res.
+        : "=w"(res) // Output operand.
+        : "w"(x), "w"(c1), "w"(c05), "w"(c166) // Input operands.
+        : "d0", "d1", "d2", "d3", "memory", "cc" // Clobbered registers.
+    );
+    return res;
+}
+
+#endif // __aarch64__
+
+#endif // BSM_KERNELS_H
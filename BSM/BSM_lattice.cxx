@@ -0,0 +1,388 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Binomial and trinomial lattices for European, American and Bermudan
+    vanillas, batched across options.
+
+    Usage: ./BSM_lattice <num_options> [steps] [crr|lr|tri] [--bbs] [--richardson]
+
+    Methods:
+        crr  Cox-Ross-Rubinstein binomial
+        lr   Leisen-Reimer binomial (Peizer-Pratt inversion, odd steps)
+        tri  Kamrad-Ritchken trinomial (lambda = sqrt(3))
+    --bbs         the last step before maturity uses Black-Scholes values
+                  (max with exercise), which removes the payoff-kink
+                  oscillation
+    --richardson  extrapolates from N and N/2 steps (order 2 for European
+                  lr, order 1 otherwise: early exercise makes lr first order)
+
+    LANES options share one backward induction: the level is a single
+    buffer laid out [node][lane], overwritten in place from the bottom
+    node up, and every inner loop runs across lanes. Bermudans exercise
+    monthly (12 dates per year, rounded to steps).
+*/
+
+/*******************************************
+ * @brief Number of options priced together, one per vector lane.
+ *******************************************/
+#define LANES 8
+
+enum exercise_kind { EXERCISE_EUROPEAN, EXERCISE_AMERICAN, EXERCISE_BERMUDAN };
+enum lattice_method { METHOD_CRR, METHOD_LR, METHOD_TRI };
+static const char *METHOD_NAMES[] = {"crr", "lr", "tri"};
+
+/*******************************************
+ * @brief Book of options in structure-of-arrays layout.
+ *******************************************/
+struct option_soa {
+    std::vector<double> S0, K, T, r, q, sigma;
+    std::vector<int> isCall, exercise;
+    std::vector<double> price;
+
+    void resize(size_t n) {
+        S0.resize(n); K.resize(n); T.resize(n); r.resize(n);
+        q.resize(n); sigma.resize(n);
+        isCall.resize(n); exercise.resize(n);
+        price.resize(n);
+    }
+};
+
+/*******************************************
+ * @brief Lattice settings shared by a run.
+ *******************************************/
+struct lattice_config {
+    int method;
+    int steps;
+    bool bbs;
+    bool richardson;
+};
+
+/*******************************************
+ * @brief Per-thread workspace: the single level buffer, sized once for
+ *        the largest lattice.
+ *******************************************/
+struct lattice_workspace {
+    std::vector<double> V;
+
+    explicit lattice_workspace(int steps) : V((2 * steps + 3) * LANES) {}
+};
+
+/*******************************************
+ * @brief Peizer-Pratt inversion (method 2) used by Leisen-Reimer.
+ *******************************************/
+static inline double peizer_pratt(double z, int n) {
+    double a = z / (n + 1.0 / 3.0 + 0.1 / (n + 1.0));
+    double s = std::sqrt(0.25 - 0.25 * std::exp(-a * a * (n + 1.0 / 6.0)));
+    return z >= 0.0 ? 0.5 + s : 0.5 - s;
+}
+
+/*******************************************
+ * @brief Prices LANES options on one lattice.
+ *
+ * Node i of level j has spot lo_j * R^i, with lo_j the lowest node.
+ * Binomial levels hold j + 1 nodes, trinomial 2j + 1. Moving from level
+ * j + 1 to j, node i only reads nodes i, i + 1 (and i + 2), so the
+ * level is updated in place in increasing i.
+ *
+ * @tparam TRI Trinomial lattice.
+ * @param o Book.
+ * @param idx Book indices of the lanes.
+ * @param method Lattice method.
+ * @param N Number of steps.
+ * @param bbs Black-Scholes values on the last step.
+ * @param w Thread workspace.
+ * @param out Prices of the lanes.
+ *******************************************/
+template <bool TRI>
+static void lattice_batch(const option_soa &o, const ui64 *idx, int method, int N,
+                          bool bbs, lattice_workspace &w, double *out) {
+    double S[LANES], K[LANES], r[LANES], q[LANES], sig[LANES], phi[LANES];
+    double dt[LANES], df[LANES], pu[LANES], pm[LANES], pd[LANES];
+    double lo0[LANES], R[LANES], up[LANES];
+    int exercise[LANES], exEvery[LANES];
+
+    for (int l = 0; l < LANES; l++) {
+        ui64 k = idx[l];
+        S[l] = o.S0[k]; K[l] = o.K[k]; r[l] = o.r[k]; q[l] = o.q[k];
+        sig[l] = o.sigma[k];
+        phi[l] = o.isCall[k] ? 1.0 : -1.0;
+        exercise[l] = o.exercise[k];
+        exEvery[l] = std::max(1, int(std::lround(N / (12.0 * o.T[k]))));
+        dt[l] = o.T[k] / N;
+        df[l] = std::exp(-r[l] * dt[l]);
+        double g = std::exp((r[l] - q[l]) * dt[l]);
+        if (TRI) {
+            double dx = sig[l] * std::sqrt(3.0 * dt[l]);
+            double nu = r[l] - q[l] - 0.5 * sig[l] * sig[l];
+            double a = (sig[l] * sig[l] * dt[l] + nu * nu * dt[l] * dt[l]) / (dx * dx);
+            double b = nu * dt[l] / dx;
+            pu[l] = 0.5 * (a + b);
+            pd[l] = 0.5 * (a - b);
+            pm[l] = 1.0 - pu[l] - pd[l];
+            R[l] = std::exp(dx);
+            lo0[l] = S[l] * std::exp(-N * dx);
+            up[l] = R[l];                  // lo_{j} = lo_{j+1} * e^{dx}
+        } else {
+            double u, d;
+            if (method == METHOD_LR) {
+                double sT = sig[l] * std::sqrt(o.T[k]);
+                double d1 = (std::log(S[l] / K[l]) + (r[l] - q[l] + 0.5 * sig[l] * sig[l]) * o.T[k]) / sT;
+                double p = peizer_pratt(d1 - sT, N), pp = peizer_pratt(d1, N);
+                u = g * pp / p;
+                d = (g - p * u) / (1.0 - p);
+                pu[l] = p;
+            } else {
+                u = std::exp(sig[l] * std::sqrt(dt[l]));
+                d = 1.0 / u;
+                pu[l] = (g - d) / (u - d);
+            }
+            pd[l] = 1.0 - pu[l];
+            pm[l] = 0.0;
+            R[l] = u / d;
+            lo0[l] = S[l] * std::pow(d, N);
+            up[l] = 1.0 / d;               // lo_{j} = lo_{j+1} / d
+        }
+    }
+
+    double *V = w.V.data();
+    const int width = TRI ? 2 : 1;
+    double lo[LANES];
+    double canEx[LANES];
+
+    // Start level: payoff at maturity, or Black-Scholes one step before it.
+    int j = bbs ? N - 1 : N;
+    for (int l = 0; l < LANES; l++) {
+        lo[l] = bbs ? lo0[l] * up[l] : lo0[l];
+        canEx[l] = (exercise[l] == EXERCISE_AMERICAN
+                    || (exercise[l] == EXERCISE_BERMUDAN && j % exEvery[l] == 0)) ? 1.0 : 0.0;
+    }
+    {
+        double s[LANES];
+        for (int l = 0; l < LANES; l++) s[l] = lo[l];
+        for (int i = 0; i <= width * j; i++) {
+            double *Vi = V + i * LANES;
+            #pragma omp simd
+            for (int l = 0; l < LANES; l++) {
+                double pay = std::max(phi[l] * (s[l] - K[l]), 0.0);
+                double v = pay;
+                if (bbs) {
+                    double e = bsm_price(s[l], K[l], dt[l], r[l], q[l], sig[l], phi[l] > 0.0);
+                    v = (canEx[l] != 0.0) ? std::max(e, pay) : e;
+                }
+                Vi[l] = v;
+                s[l] *= R[l];
+            }
+        }
+    }
+
+    // Backward induction in the single buffer.
+    for (j = j - 1; j >= 0; j--) {
+        double s[LANES];
+        for (int l = 0; l < LANES; l++) {
+            lo[l] *= up[l];
+            s[l] = lo[l];
+            canEx[l] = (exercise[l] == EXERCISE_AMERICAN
+                        || (exercise[l] == EXERCISE_BERMUDAN && j > 0 && j % exEvery[l] == 0)) ? 1.0 : 0.0;
+        }
+        for (int i = 0; i <= width * j; i++) {
+            double *Vi = V + i * LANES;
+            #pragma omp simd
+            for (int l = 0; l < LANES; l++) {
+                double cont = TRI
+                    ? df[l] * (pd[l] * Vi[l] + pm[l] * Vi[l + LANES] + pu[l] * Vi[l + 2 * LANES])
+                    : df[l] * (pd[l] * Vi[l] + pu[l] * Vi[l + LANES]);
+                double pay = std::max(phi[l] * (s[l] - K[l]), 0.0);
+                Vi[l] = (canEx[l] != 0.0) ? std::max(cont, pay) : cont;
+                s[l] *= R[l];
+            }
+        }
+    }
+
+    for (int l = 0; l < LANES; l++) out[l] = V[l];
+}
+
+/*******************************************
+ * @brief One batch with the configured method, BBS and extrapolation.
+ *******************************************/
+static void price_batch(const option_soa &o, const ui64 *idx, const lattice_config &c,
+                        lattice_workspace &w, double *out) {
+    auto run = [&](int N, double *res) {
+        if (c.method == METHOD_LR) N |= 1;
+        if (c.method == METHOD_TRI) lattice_batch<true>(o, idx, c.method, N, c.bbs, w, res);
+        else lattice_batch<false>(o, idx, c.method, N, c.bbs, w, res);
+    };
+    run(c.steps, out);
+    if (!c.richardson) return;
+    double half[LANES];
+    run(c.steps / 2, half);
+    // LR converges in 1/N^2 for Europeans only; with early exercise, and
+    // for CRR and the trinomial (with BBS), the leading error is 1/N.
+    for (int l = 0; l < LANES; l++) {
+        bool second = c.method == METHOD_LR && o.exercise[idx[l]] == EXERCISE_EUROPEAN;
+        double f = second ? 4.0 : 2.0;
+        out[l] = (f * out[l] - half[l]) / (f - 1.0);
+    }
+}
+
+/*******************************************
+ * @brief Prices the whole book, one batch of LANES options per task.
+ *
+ * @param o Book (prices are written to o.price).
+ * @param c Lattice settings.
+ *******************************************/
+static void lattice_price_book(option_soa &o, const lattice_config &c) {
+    ui64 n = o.S0.size();
+    ui64 nBatches = (n + LANES - 1) / LANES;
+
+    #pragma omp parallel
+    {
+        lattice_workspace w(c.steps | 1);
+
+        #pragma omp for schedule(dynamic, 4)
+        for (ui64 b = 0; b < nBatches; b++) {
+            ui64 idx[LANES];
+            double out[LANES];
+            for (int l = 0; l < LANES; l++) {
+                ui64 k = b * LANES + l;
+                idx[l] = (k < n) ? k : b * LANES; // Pad with the first lane.
+            }
+            price_batch(o, idx, c, w, out);
+            for (int l = 0; l < LANES; l++) {
+                if (b * LANES + l < n) o.price[b * LANES + l] = out[l];
+            }
+        }
+    }
+}
+
+/*******************************************
+ * @brief Main function: convergence table on an American put, then a
+ *        random book.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <num_options> [steps] [crr|lr|tri] [--bbs] [--richardson]\n";
+        return 1;
+    }
+    ui64 nOpt = std::stoull(argv[1]);
+    lattice_config cfg = {METHOD_LR, 101, false, false};
+    for (int a = 2; a < argc; a++) {
+        std::string opt = argv[a];
+        if (opt == "crr") cfg.method = METHOD_CRR;
+        else if (opt == "lr") cfg.method = METHOD_LR;
+        else if (opt == "tri") cfg.method = METHOD_TRI;
+        else if (opt == "--bbs") cfg.bbs = true;
+        else if (opt == "--richardson") cfg.richardson = true;
+        else cfg.steps = std::atoi(argv[a]);
+    }
+    if (nOpt == 0 || cfg.steps < 4) {
+        std::cerr << "Need num_options > 0 and steps >= 4\n";
+        return 1;
+    }
+
+    // Convergence on the reference American put (S0=100, K=110, T=1, r=0.06, sigma=0.2).
+    option_soa ref;
+    ref.resize(1);
+    ref.S0[0] = 100.0; ref.K[0] = 110.0; ref.T[0] = 1.0; ref.r[0] = 0.06;
+    ref.q[0] = 0.0; ref.sigma[0] = 0.2; ref.isCall[0] = 0; ref.exercise[0] = EXERCISE_AMERICAN;
+    ui64 refIdx[LANES] = {0};
+    double tmp[LANES];
+    {
+        lattice_config hi = {METHOD_CRR, 8000, true, true};
+        lattice_workspace w(hi.steps);
+        price_batch(ref, refIdx, hi, w, tmp);
+    }
+    const double refPrice = tmp[0];
+    std::cout << "American put S0=100 K=110: reference (crr 8000 + bbs + richardson)= "
+              << std::fixed << std::setprecision(6) << refPrice << "\n"
+              << "steps      crr    crr+bbs+rich     lr      lr+rich     tri    tri+bbs+rich\n";
+    const lattice_config variants[6] = {
+        {METHOD_CRR, 0, false, false}, {METHOD_CRR, 0, true, true},
+        {METHOD_LR, 0, false, false},  {METHOD_LR, 0, false, true},
+        {METHOD_TRI, 0, false, false}, {METHOD_TRI, 0, true, true}};
+    for (int N = 25; N <= 800; N *= 2) {
+        std::cout << std::setw(5) << N;
+        for (const lattice_config &v0 : variants) {
+            lattice_config v = v0;
+            v.steps = N;
+            lattice_workspace w(N | 1);
+            price_batch(ref, refIdx, v, w, tmp);
+            std::cout << std::scientific << std::setprecision(1) << std::setw(11)
+                      << tmp[0] - refPrice;
+        }
+        std::cout << "\n";
+    }
+
+    // Random book: same distribution as BSM_pde, plus monthly Bermudans.
+    option_soa o;
+    o.resize(nOpt);
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, 0xC0FFEEULL);
+    for (ui64 k = 0; k < nOpt; k++) {
+        o.S0[k] = 80.0 + 40.0 * uniform01(rng);
+        o.K[k] = 100.0;
+        o.T[k] = 0.25 + 1.75 * uniform01(rng);
+        o.r[k] = 0.06 * uniform01(rng);
+        o.q[k] = 0.03 * uniform01(rng);
+        o.sigma[k] = 0.1 + 0.3 * uniform01(rng);
+        o.isCall[k] = (xorshift128plus(rng) >> 63) ? 1 : 0;
+        o.exercise[k] = int(xorshift128plus(rng) % 3);
+    }
+
+    std::cout << "Lattice " << METHOD_NAMES[cfg.method] << (cfg.bbs ? "+bbs" : "")
+              << (cfg.richardson ? "+richardson" : "") << "   options= " << nOpt
+              << "   steps= " << cfg.steps << "   lanes= " << LANES
+              << "   threads= " << omp_get_max_threads() << std::endl;
+
+    double t1 = dml_micros();
+    lattice_price_book(o, cfg);
+    double t2 = dml_micros();
+
+    double sum = 0.0, maxErr = 0.0, maxAmerGap = 0.0;
+    for (ui64 k = 0; k < nOpt; k++) {
+        sum += o.price[k];
+        double euro = bsm_price(o.S0[k], o.K[k], o.T[k], o.r[k], o.q[k], o.sigma[k], o.isCall[k]);
+        if (o.exercise[k] == EXERCISE_EUROPEAN) maxErr = std::max(maxErr, std::fabs(o.price[k] - euro));
+        else maxAmerGap = std::max(maxAmerGap, euro - o.price[k]);
+    }
+
+    // Early-exercise accuracy on the first options of the book.
+    option_soa s;
+    ui64 nCheck = std::min<ui64>(nOpt, 64);
+    s.resize(nCheck);
+    for (ui64 k = 0; k < nCheck; k++) {
+        s.S0[k] = o.S0[k]; s.K[k] = o.K[k]; s.T[k] = o.T[k]; s.r[k] = o.r[k];
+        s.q[k] = o.q[k]; s.sigma[k] = o.sigma[k]; s.isCall[k] = o.isCall[k];
+        s.exercise[k] = o.exercise[k];
+    }
+    lattice_price_book(s, {METHOD_CRR, 4000, true, true});
+    double maxEarly = 0.0;
+    for (ui64 k = 0; k < nCheck; k++)
+        if (s.exercise[k] != EXERCISE_EUROPEAN) maxEarly = std::max(maxEarly, std::fabs(o.price[k] - s.price[k]));
+
+    double elapsed = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(6)
+              << "  max |European - BSM| = " << maxErr
+              << "   max (European - early exercise) = " << maxAmerGap
+              << "   max |early exercise - crr 4000 bbs+rich| = " << maxEarly << "\n"
+              << std::setprecision(0) << "  " << double(nOpt) / elapsed << " options/s   "
+              << double(nOpt) / elapsed / omp_get_max_threads() << " options/s/thread\n";
+    std::cout << std::setprecision(6)
+              << "value= " << sum / double(nOpt) << " in " << elapsed << " s\n";
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define ui64 uint64_t
+
+/*
+    Load generator for BSM_server.
+
+    Usage: ./BSM_loadgen <socket_path> <clients> <requests_per_client> [num_sims]
+
+    Every client keeps one request in flight (closed loop) and measures the
+    time from sending a request line to receiving its answer. Reports the
+    latency percentiles and the aggregate throughput.
+*/
+
+/*******************************************
+ * @brief Returns the current time in microseconds.
+ *
+ * @return Current time in microseconds.
+ *******************************************/
+static double dml_micros() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return double(tv.tv_sec) * 1e6 + double(tv.tv_usec);
+}
+
+/*******************************************
+ * @brief Runs one closed-loop client.
+ *
+ * @param path Server socket.
+ * @param clientId Client index (varies the contracts).
+ * @param nReq Number of requests to send.
+ * @param nSim Paths per request.
+ * @param lat Output latencies in microseconds.
+ * @param failed Set when the connection breaks.
+ *******************************************/
+static void run_client(const std::string &path, int clientId, int nReq, ui64 nSim,
+                       std::vector<double> &lat, bool &failed) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        failed = true;
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    std::string pending;
+    char buf[4096];
+    lat.reserve(nReq);
+    for (int i = 0; i < nReq; i++) {
+        char line[256];
+        double K = 90.0 + double((clientId * 7 + i) % 41);
+        int len = std::snprintf(line, sizeof(line), "c%d-%d %c 100 %.1f 1.0 0.06 0.2 0.03 %llu\n",
+                                clientId, i, (i & 1) ? 'P' : 'C', K,
+                                (unsigned long long)nSim);
+        double t0 = dml_micros();
+        if (write(fd, line, size_t(len)) != len) { failed = true; break; }
+
+        size_t pos;
+        while ((pos = pending.find('\n')) == std::string::npos) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) { failed = true; break; }
+            pending.append(buf, size_t(n));
+        }
+        if (failed) break;
+        pending.erase(0, pos + 1);
+        lat.push_back(dml_micros() - t0);
+    }
+    close(fd);
+}
+
+/*******************************************
+ * @brief Main function: spawns the clients and reports latency statistics.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <socket_path> <clients> <requests_per_client> [num_sims]\n";
+        return 1;
+    }
+    std::string path = argv[1];
+    int nClients = std::atoi(argv[2]);
+    int nReq = std::atoi(argv[3]);
+    ui64 nSim = (argc > 4) ? std::stoull(argv[4]) : 10000;
+
+    std::vector<std::vector<double>> lat(nClients);
+    std::vector<char> failed(nClients, 0);
+    std::vector<std::thread> th;
+
+    double t1 = dml_micros();
+    for (int c = 0; c < nClients; c++) {
+        th.emplace_back([&, c] {
+            bool f = false;
+            run_client(path, c, nReq, nSim, lat[c], f);
+            failed[c] = f;
+        });
+    }
+    for (auto &t : th) t.join();
+    double t2 = dml_micros();
+
+    std::vector<double> all;
+    for (auto &v : lat) all.insert(all.end(), v.begin(), v.end());
+    int nFailed = int(std::count(failed.begin(), failed.end(), 1));
+    if (all.empty()) {
+        std::cerr << "No request completed (is BSM_server listening on " << path << "?)\n";
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) { return all[std::min(all.size() - 1, size_t(p * all.size()))]; };
+
+    double elapsed = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(1)
+              << "clients= " << nClients << "   requests= " << all.size()
+              << "   num_sims= " << nSim << "   failed_clients= " << nFailed << "\n"
+              << "latency us: p50= " << pct(0.50) << "   p99= " << pct(0.99)
+              << "   max= " << all.back() << "\n"
+              << std::setprecision(6)
+              << "throughput= " << double(all.size()) / elapsed << " req/s in "
+              << elapsed << " s\n";
+    return nFailed ? 1 : 0;
+}
@@ -0,0 +1,339 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Path engine with term structures and a Dupire local-volatility surface.
+
+    Usage: ./BSM_localvol <num_sims> [steps_per_year]
+
+    Market objects:
+        rate_curve    piecewise-constant forward rates (also used for q)
+        vol_surface   50 x 50 local-vol nodes on (T, y = ln(K / F(T))),
+                      built with Dupire's formula (total-variance form)
+                      from a parametric implied-vol smile
+    Before simulating, everything is resampled onto the time steps:
+        r_n, q_n              mean forward rates over step n
+        lv[n][j], dlv[n][j]   local vol and slope on a uniform ln S grid
+                              shifted by ln F(t_n)
+    so a path step is one index computation, one gather and one fma for
+    the local vol, with no search. Paths are stepped in blocks of CHUNK,
+    the step loop outside and the SIMD path loop inside.
+
+    The check reprices calls across strikes from the same paths, inverts
+    the prices to implied vols and compares with the input smile. The
+    cost of the table lookups is measured against the same engine with a
+    scalar volatility.
+*/
+
+#define CHUNK 256
+#define SURF_NT 50
+#define SURF_NY 50
+
+/*******************************************
+ * @brief Piecewise-constant forward rate curve.
+ *
+ * rate[i] applies on [time[i-1], time[i]); the last rate extends
+ * beyond the last knot.
+ *******************************************/
+struct rate_curve {
+    std::vector<double> time, rate;
+
+    /*******************************************
+     * @brief Integral of the forward rate over [0, t].
+     *******************************************/
+    double integral(double t) const {
+        double acc = 0.0, prev = 0.0;
+        for (size_t i = 0; i < time.size(); i++) {
+            if (t <= time[i]) return acc + rate[i] * (t - prev);
+            acc += rate[i] * (time[i] - prev);
+            prev = time[i];
+        }
+        return acc + rate.back() * (t - prev);
+    }
+};
+
+/*******************************************
+ * @brief Parametric implied-vol smile used to build the surface.
+ *
+ * @param y Log-moneyness ln(K / F(T)).
+ * @param T Maturity.
+ * @return Implied volatility.
+ *******************************************/
+static double smile_vol(double y, double T) {
+    double atm = 0.18 + 0.04 * std::exp(-2.0 * T);
+    double skew = -0.12 / std::sqrt(T + 0.25);
+    return atm + skew * y * 0.5 + 0.10 * y * y;
+}
+
+/*******************************************
+ * @brief Local-vol nodes on (T, y), from Dupire's formula.
+ *
+ * In total implied variance w(y, T) = T sigma_imp^2:
+ *   sigma_loc^2 = w_T / (1 - y w_y / w + (-1/4 - 1/w + y^2 / w^2) w_y^2 / 4 + w_yy / 2)
+ * with derivatives by central differences. Nodes where the denominator
+ * or w_T is not positive are floored.
+ *******************************************/
+struct vol_surface {
+    double t[SURF_NT], y[SURF_NY];
+    double lv[SURF_NT][SURF_NY];
+
+    void build_dupire() {
+        for (int i = 0; i < SURF_NT; i++) t[i] = 0.02 + 2.0 * i / (SURF_NT - 1);
+        for (int j = 0; j < SURF_NY; j++) y[j] = -1.5 + 3.0 * j / (SURF_NY - 1);
+        auto w = [](double yy, double tt) {
+            double v = smile_vol(yy, tt);
+            return tt * v * v;
+        };
+        const double hy = 1e-4, ht = 1e-4;
+        for (int i = 0; i < SURF_NT; i++) {
+            for (int j = 0; j < SURF_NY; j++) {
+                double T = t[i], Y = y[j];
+                double w0 = w(Y, T);
+                double wT = (w(Y, T + ht) - w(Y, std::max(T - ht, 1e-6))) / (T + ht - std::max(T - ht, 1e-6));
+                double wy = (w(Y + hy, T) - w(Y - hy, T)) / (2.0 * hy);
+                double wyy = (w(Y + hy, T) - 2.0 * w0 + w(Y - hy, T)) / (hy * hy);
+                double den = 1.0 - Y * wy / w0
+                           + 0.25 * (-0.25 - 1.0 / w0 + Y * Y / (w0 * w0)) * wy * wy
+                           + 0.5 * wyy;
+                double v2 = wT / std::max(den, 1e-3);
+                lv[i][j] = std::sqrt(std::min(std::max(v2, 1e-4), 4.0));
+            }
+        }
+    }
+
+    /*******************************************
+     * @brief Bilinear interpolation (flat outside the grid).
+     *******************************************/
+    double at(double T, double Y) const {
+        auto locate = [](const double *g, int n, double v, int &k, double &f) {
+            if (v <= g[0]) { k = 0; f = 0.0; return; }
+            if (v >= g[n - 1]) { k = n - 2; f = 1.0; return; }
+            k = int(std::upper_bound(g, g + n, v) - g) - 1;
+            f = (v - g[k]) / (g[k + 1] - g[k]);
+        };
+        int i, j;
+        double ft, fy;
+        locate(t, SURF_NT, T, i, ft);
+        locate(y, SURF_NY, Y, j, fy);
+        double a = lv[i][j] + fy * (lv[i][j + 1] - lv[i][j]);
+        double b = lv[i + 1][j] + fy * (lv[i + 1][j + 1] - lv[i + 1][j]);
+        return a + ft * (b - a);
+    }
+};
+
+/*******************************************
+ * @brief Per-step lookup tables (SoA, one row per time step).
+ *
+ * Row n covers ln S in [x0[n], x0[n] + (NX-1) dx] with uniform spacing;
+ * lv[n*NX + j] is the local vol at node j and dlv its slope to node
+ * j+1, so lookups are val + frac * slope after one floor.
+ *******************************************/
+struct step_tables {
+    int nSteps, NX;
+    double dt, dx, invDx;
+    std::vector<double> rq;     // (r_n - q_n) * dt
+    std::vector<double> x0;
+    std::vector<double> lv, dlv;
+    double logDiscount;         // -integral of r to maturity
+
+    void build(const rate_curve &r, const rate_curve &q, const vol_surface &S,
+               double S0, double T, int steps, int nx) {
+        nSteps = steps;
+        NX = nx;
+        dt = T / steps;
+        const double yMin = S.y[0], yMax = S.y[SURF_NY - 1];
+        dx = (yMax - yMin) / (NX - 1);
+        invDx = 1.0 / dx;
+        rq.resize(steps);
+        x0.resize(steps);
+        lv.resize(size_t(steps) * NX);
+        dlv.resize(size_t(steps) * NX);
+        for (int n = 0; n < steps; n++) {
+            double ta = n * dt, tb = (n + 1) * dt;
+            double rr = r.integral(tb) - r.integral(ta);
+            double qq = q.integral(tb) - q.integral(ta);
+            rq[n] = rr - qq;
+            double lnF = std::log(S0) + r.integral(ta) - q.integral(ta);
+            x0[n] = lnF + yMin;
+            double tm = std::max(ta, 0.5 * dt);   // local vol at the step start
+            for (int j = 0; j < NX; j++) lv[size_t(n) * NX + j] = S.at(tm, yMin + j * dx);
+            for (int j = 0; j < NX - 1; j++) {
+                dlv[size_t(n) * NX + j] = lv[size_t(n) * NX + j + 1] - lv[size_t(n) * NX + j];
+            }
+            dlv[size_t(n) * NX + NX - 1] = 0.0;
+        }
+        logDiscount = -r.integral(T);
+    }
+};
+
+/*******************************************
+ * @brief Simulates all paths and prices calls at several strikes.
+ *
+ * Log-Euler step: ln S += (r_n - q_n) dt - sigma^2 dt / 2 + sigma sqrt(dt) z,
+ * sigma = local vol looked up at ln S (LOCAL) or a scalar (flat).
+ *
+ * @tparam LOCAL Use the local-vol tables.
+ * @param tb Step tables.
+ * @param S0 Spot.
+ * @param flatVol Scalar volatility when !LOCAL.
+ * @param strikes Strikes.
+ * @param nSim Paths (rounded up to CHUNK).
+ * @param sum Output undiscounted payoff sums per strike.
+ * @param sumSq Output squared sums per strike.
+ *******************************************/
+template <bool LOCAL>
+static void simulate(const step_tables &tb, double S0, double flatVol,
+                     const std::vector<double> &strikes, ui64 nSim,
+                     std::vector<double> &sum, std::vector<double> &sumSq) {
+    const ui64 nBlocks = (nSim + CHUNK - 1) / CHUNK;
+    const int nK = int(strikes.size());
+    const double dt = tb.dt, sqdt = std::sqrt(tb.dt), invDx = tb.invDx;
+    const int NX = tb.NX;
+    sum.assign(nK, 0.0);
+    sumSq.assign(nK, 0.0);
+
+    #pragma omp parallel
+    {
+        alignas(64) double x[CHUNK], g[CHUNK];
+        std::vector<double> ls(nK, 0.0), ls2(nK, 0.0);
+
+        #pragma omp for schedule(static)
+        for (ui64 b = 0; b < nBlocks; b++) {
+            xorshift128plus_state rng;
+            xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0x9E37ULL * (b + 1))));
+            for (int i = 0; i < CHUNK; i++) x[i] = std::log(S0);
+
+            for (int n = 0; n < tb.nSteps; n++) {
+                normal_block(rng, g, CHUNK);
+                const double mu = tb.rq[n];
+                const double x0 = tb.x0[n];
+                const double *lv = &tb.lv[size_t(n) * NX];
+                const double *dlv = &tb.dlv[size_t(n) * NX];
+
+                #pragma omp simd
+                for (int i = 0; i < CHUNK; i++) {
+                    double sig = flatVol;
+                    if (LOCAL) {
+                        double u = (x[i] - x0) * invDx;
+                        u = std::min(std::max(u, 0.0), double(NX - 1));
+                        int j = int(u);
+                        double f = u - j;
+                        sig = lv[j] + f * dlv[j];
+                    }
+                    x[i] += mu - 0.5 * sig * sig * dt + sig * sqdt * g[i];
+                }
+            }
+
+            for (int k = 0; k < nK; k++) {
+                double K = strikes[k], s = 0.0, s2 = 0.0;
+                #pragma omp simd reduction(+:s, s2)
+                for (int i = 0; i < CHUNK; i++) {
+                    double p = std::max(std::exp(x[i]) - K, 0.0);
+                    s += p;
+                    s2 += p * p;
+                }
+                ls[k] += s;
+                ls2[k] += s2;
+            }
+        }
+
+        #pragma omp critical
+        for (int k = 0; k < nK; k++) {
+            sum[k] += ls[k];
+            sumSq[k] += ls2[k];
+        }
+    }
+}
+
+/*******************************************
+ * @brief Black call on a forward, discounted.
+ *******************************************/
+static double black_call(double F, double K, double T, double D, double vol) {
+    double sq = vol * std::sqrt(T);
+    double d1 = (std::log(F / K) + 0.5 * sq * sq) / sq;
+    return D * (F * norm_cdf(d1) - K * norm_cdf(d1 - sq));
+}
+
+/*******************************************
+ * @brief Implied vol by bisection (robust, enough for a report).
+ *******************************************/
+static double implied_vol(double price, double F, double K, double T, double D) {
+    double lo = 1e-4, hi = 3.0;
+    for (int it = 0; it < 100; it++) {
+        double mid = 0.5 * (lo + hi);
+        if (black_call(F, K, T, D, mid) > price) hi = mid; else lo = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+/*******************************************
+ * @brief Main function: local-vol repricing check and lookup cost.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <num_sims> [steps_per_year]\n";
+        return 1;
+    }
+    ui64 nSim = std::stoull(argv[1]);
+    int stepsPerYear = (argc > 2) ? std::atoi(argv[2]) : 100;
+    const double S0 = 100.0, T = 1.0;
+    const int steps = std::max(1, int(stepsPerYear * T));
+
+    rate_curve r = {{0.25, 0.5, 1.0, 2.0}, {0.030, 0.035, 0.040, 0.045}};
+    rate_curve q = {{0.5, 2.0}, {0.010, 0.020}};
+    vol_surface surf;
+    surf.build_dupire();
+    step_tables tb;
+    tb.build(r, q, surf, S0, T, steps, 4 * SURF_NY);
+
+    std::vector<double> strikes = {70, 80, 90, 100, 110, 120, 130};
+    std::vector<double> sum, sumSq;
+
+    double t0 = dml_micros();
+    simulate<false>(tb, S0, 0.2, strikes, nSim, sum, sumSq);
+    double t1 = dml_micros();
+    simulate<true>(tb, S0, 0.0, strikes, nSim, sum, sumSq);
+    double t2 = dml_micros();
+
+    double N = double((nSim + CHUNK - 1) / CHUNK * CHUNK);
+    double D = std::exp(tb.logDiscount);
+    double F = S0 * std::exp(r.integral(T) - q.integral(T));
+
+    std::cout << "    K    price (+- se)          mc vol    input vol   diff (vol pts)\n";
+    for (size_t k = 0; k < strikes.size(); k++) {
+        double m = sum[k] / N;
+        double se = std::sqrt(std::max(sumSq[k] / N - m * m, 0.0) / N);
+        double price = D * m;
+        double iv = implied_vol(price, F, strikes[k], T, D);
+        double ref = smile_vol(std::log(strikes[k] / F), T);
+        std::cout << std::fixed << std::setw(5) << std::setprecision(0) << strikes[k]
+                  << std::setprecision(6) << std::setw(11) << price << " +- " << D * se
+                  << std::setw(11) << iv << std::setw(11) << ref
+                  << std::setw(11) << std::setprecision(3) << 100.0 * (iv - ref) << "\n";
+    }
+
+    double flatTime = (t1 - t0) * 1e-6, lvTime = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(3)
+              << "steps= " << steps << "   path steps/s= " << std::scientific
+              << N * steps / lvTime << std::fixed
+              << "   local-vol / flat-vol time= " << lvTime / flatTime << "\n";
+
+    double atm = sum[3] / N * D;
+    std::cout << std::fixed << std::setprecision(6)
+              << "value= " << atm << " in " << lvTime << " s\n";
+    return 0;
+}
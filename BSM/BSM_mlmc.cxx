@@ -0,0 +1,365 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Multilevel Monte Carlo (Giles) for discretely simulated path-dependent
+    options under Black-Scholes dynamics.
+
+    Usage: ./BSM_mlmc <asian|barrier|european> <rms_error> [barrier_level]
+
+    Level l uses 2^l Milstein steps. Each sample of level l > 0 is a pair
+    of paths, fine (2^l steps) and coarse (2^(l-1) steps), driven by the
+    same Brownian increments; the estimator sums E[P_0] and the corrections
+    E[P_l - P_(l-1)]. Per-level means, variances and costs are estimated
+    online and the sample counts N_l are set to the optimum
+
+        N_l = 2 / eps^2 * sqrt(V_l / C_l) * sum_k sqrt(V_k C_k)
+
+    until the estimated bias of the finest level drops below eps / sqrt(2).
+
+    Products (S0=100, K=100, T=1, r=0.05, sigma=0.2):
+        asian     arithmetic-average call, trapezoidal average
+        barrier   down-and-out call (default barrier 85); the coarse path
+                  uses the Brownian-bridge midpoint taken from the fine
+                  increments and the step survival probabilities
+        european  plain call, checked against the closed form
+*/
+
+#define CHUNK 256
+#define MAX_LEVEL 16
+
+enum product_kind { ASIAN, BARRIER, EUROPEAN };
+
+/*******************************************
+ * @brief Contract and model parameters.
+ *******************************************/
+struct mlmc_params {
+    double S0, K, T, r, sigma, B;
+};
+
+/*******************************************
+ * @brief Sums accumulated for one level.
+ *
+ * Y = P_l - P_(l-1) (or P_0 on level 0); P = P_l alone, used to report
+ * the cost of plain Monte Carlo at the same accuracy.
+ *******************************************/
+struct level_sums {
+    double sumY, sumY2, sumP, sumP2;
+};
+
+/*******************************************
+ * @brief Probability that a Brownian bridge stays above B over one step.
+ *
+ * @param a Start value.
+ * @param b End value.
+ * @param B Barrier.
+ * @param var Variance of the step (vol^2 * h).
+ * @return Survival probability.
+ *******************************************/
+static inline double bridge_survival(double a, double b, double B, double var) {
+    double da = a - B, db = b - B;
+    return (da > 0.0 && db > 0.0) ? 1.0 - std::exp(-2.0 * da * db / var) : 0.0;
+}
+
+/*******************************************
+ * @brief Simulates one block of CHUNK coupled path pairs on a level.
+ *
+ * Paths of the block are laid out side by side and advanced step by
+ * step, so every inner loop runs across CHUNK independent paths.
+ *
+ * @tparam PRODUCT Payoff.
+ * @param p Parameters.
+ * @param level Level (2^level fine steps).
+ * @param seed Block seed.
+ * @param out Output sums (accumulated).
+ *******************************************/
+template <int PRODUCT>
+static void mlmc_block(const mlmc_params &p, int level, ui64 seed, level_sums &out) {
+    alignas(64) double Sf[CHUNK], Sc[CHUNK], Af[CHUNK], Ac[CHUNK];
+    alignas(64) double Pf[CHUNK], Pc[CHUNK], d1[CHUNK], d2[CHUNK];
+
+    const int nf = 1 << level;
+    const double hf = p.T / nf;
+    const double sqh = std::sqrt(hf);
+    const double r = p.r, sg = p.sigma, B = p.B;
+
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, seed_mix(seed));
+
+    for (int i = 0; i < CHUNK; i++) {
+        Sf[i] = Sc[i] = p.S0;
+        Af[i] = Ac[i] = 0.0;
+        Pf[i] = Pc[i] = 1.0;
+    }
+
+    // One iteration per coarse step (a single fine step on level 0).
+    const int nSteps = level ? nf / 2 : 1;
+    for (int n = 0; n < nSteps; n++) {
+        for (int i = 0; i < CHUNK; i++) {
+            double u1 = uniform01(rng);
+            double u2 = uniform01(rng);
+            box_muller_pair(u1, u2, d1[i], d2[i]);
+            d1[i] *= sqh;
+            d2[i] *= sqh;
+        }
+
+        if (level == 0) {
+            #pragma omp simd
+            for (int i = 0; i < CHUNK; i++) {
+                double s = Sf[i], dw = d1[i];
+                double s1 = s * (1.0 + r * hf + sg * dw + 0.5 * sg * sg * (dw * dw - hf));
+                Af[i] += 0.5 * hf * (s + s1);
+                Pf[i] *= bridge_survival(s, s1, B, sg * sg * s * s * hf);
+                Sf[i] = s1;
+            }
+            continue;
+        }
+
+        #pragma omp simd
+        for (int i = 0; i < CHUNK; i++) {
+            // Fine path: two Milstein steps.
+            double s = Sf[i], w1 = d1[i], w2 = d2[i];
+            double s1 = s * (1.0 + r * hf + sg * w1 + 0.5 * sg * sg * (w1 * w1 - hf));
+            double s2 = s1 * (1.0 + r * hf + sg * w2 + 0.5 * sg * sg * (w2 * w2 - hf));
+            Af[i] += 0.5 * hf * (s + 2.0 * s1 + s2);
+            Pf[i] *= bridge_survival(s, s1, B, sg * sg * s * s * hf)
+                   * bridge_survival(s1, s2, B, sg * sg * s1 * s1 * hf);
+            Sf[i] = s2;
+
+            // Coarse path: one step with the summed increment.
+            double c = Sc[i], hc = 2.0 * hf, dw = w1 + w2;
+            double c1 = c * (1.0 + r * hc + sg * dw + 0.5 * sg * sg * (dw * dw - hc));
+            Ac[i] += 0.5 * hc * (c + c1);
+            // Midpoint from the fine Brownian path: E[survival | midpoint]
+            // multiplies out to the one-step survival of the coarse level.
+            double mid = 0.5 * (c + c1) + sg * c * 0.5 * (w1 - w2);
+            double var = sg * sg * c * c * hf;
+            Pc[i] *= bridge_survival(c, mid, B, var) * bridge_survival(mid, c1, B, var);
+            Sc[i] = c1;
+        }
+    }
+
+    double sY = 0.0, sY2 = 0.0, sP = 0.0, sP2 = 0.0;
+    #pragma omp simd reduction(+:sY, sY2, sP, sP2)
+    for (int i = 0; i < CHUNK; i++) {
+        double pf, pc;
+        if (PRODUCT == ASIAN) {
+            pf = std::max(Af[i] / p.T - p.K, 0.0);
+            pc = std::max(Ac[i] / p.T - p.K, 0.0);
+        } else if (PRODUCT == BARRIER) {
+            pf = std::max(Sf[i] - p.K, 0.0) * Pf[i];
+            pc = std::max(Sc[i] - p.K, 0.0) * Pc[i];
+        } else {
+            pf = std::max(Sf[i] - p.K, 0.0);
+            pc = std::max(Sc[i] - p.K, 0.0);
+        }
+        double y = level ? pf - pc : pf;
+        sY += y;
+        sY2 += y * y;
+        sP += pf;
+        sP2 += pf * pf;
+    }
+    out.sumY += sY;
+    out.sumY2 += sY2;
+    out.sumP += sP;
+    out.sumP2 += sP2;
+}
+
+/*******************************************
+ * @brief Adds nBlocks blocks of samples to a level, in parallel.
+ *
+ * Block b of level l is seeded from (l, b), so the estimate does not
+ * depend on the thread count.
+ *
+ * @param product Payoff.
+ * @param p Parameters.
+ * @param level Level.
+ * @param firstBlock Index of the first new block on this level.
+ * @param nBlocks Number of blocks to simulate.
+ * @param acc Level sums (accumulated).
+ *******************************************/
+static void run_level(int product, const mlmc_params &p, int level,
+                      ui64 firstBlock, ui64 nBlocks, level_sums &acc) {
+    double sY = 0.0, sY2 = 0.0, sP = 0.0, sP2 = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sY, sY2, sP, sP2)
+    for (ui64 b = 0; b < nBlocks; b++) {
+        level_sums s = {0.0, 0.0, 0.0, 0.0};
+        ui64 seed = 0xDEADBEEF ^ (0xA5ULL * ui64(level + 1)) ^ (0x9E3779B9ULL * (firstBlock + b + 1));
+        if (product == ASIAN) mlmc_block<ASIAN>(p, level, seed, s);
+        else if (product == BARRIER) mlmc_block<BARRIER>(p, level, seed, s);
+        else mlmc_block<EUROPEAN>(p, level, seed, s);
+        sY += s.sumY;
+        sY2 += s.sumY2;
+        sP += s.sumP;
+        sP2 += s.sumP2;
+    }
+    acc.sumY += sY;
+    acc.sumY2 += sY2;
+    acc.sumP += sP;
+    acc.sumP2 += sP2;
+}
+
+/*******************************************
+ * @brief Continuously monitored down-and-out call (B <= K).
+ *******************************************/
+static double down_and_out_call(const mlmc_params &p) {
+    double k = 2.0 * p.r / (p.sigma * p.sigma);
+    double img = p.B * p.B / p.S0;
+    return bsm_price(p.S0, p.K, p.T, p.r, 0.0, p.sigma, 1)
+         - std::pow(p.S0 / p.B, 1.0 - k) * bsm_price(img, p.K, p.T, p.r, 0.0, p.sigma, 1);
+}
+
+/*******************************************
+ * @brief Least-squares slope of y against 1..n (levels 1..L).
+ *******************************************/
+static double level_slope(const std::vector<double> &y) {
+    double n = double(y.size()), sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (size_t i = 0; i < y.size(); i++) {
+        double x = double(i + 1);
+        sx += x; sy += y[i]; sxx += x * x; sxy += x * y[i];
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+/*******************************************
+ * @brief Main function: MLMC driver with online sample allocation.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <asian|barrier|european> <rms_error> [barrier_level]\n";
+        return 1;
+    }
+    std::string name = argv[1];
+    int product = name == "asian" ? ASIAN : name == "barrier" ? BARRIER
+                : name == "european" ? EUROPEAN : -1;
+    if (product < 0) {
+        std::cerr << "Unknown product " << name << "\n";
+        return 1;
+    }
+    double eps = std::atof(argv[2]);
+    mlmc_params p = {100.0, 100.0, 1.0, 0.05, 0.2, 0.0};
+    if (product == BARRIER) p.B = (argc > 3) ? std::atof(argv[3]) : 85.0;
+
+    const ui64 N0 = 16 * CHUNK;     // initial samples on a new level
+    int L = 2;
+    std::vector<level_sums> sums(MAX_LEVEL + 1, level_sums{0.0, 0.0, 0.0, 0.0});
+    std::vector<ui64> N(MAX_LEVEL + 1, 0), dN(MAX_LEVEL + 1, 0);
+    std::vector<double> Y(MAX_LEVEL + 1, 0.0), V(MAX_LEVEL + 1, 0.0), C(MAX_LEVEL + 1, 0.0);
+    for (int l = 0; l <= L; l++) dN[l] = N0;
+
+    double alpha = 1.0, beta = 1.0;
+    bool converged = false;
+
+    double t1 = dml_micros();
+
+    while (!converged) {
+        for (int l = 0; l <= L; l++) {
+            if (dN[l] == 0) continue;
+            ui64 nBlocks = (dN[l] + CHUNK - 1) / CHUNK;
+            run_level(product, p, l, N[l] / CHUNK, nBlocks, sums[l]);
+            N[l] += nBlocks * CHUNK;
+            dN[l] = 0;
+        }
+
+        for (int l = 0; l <= L; l++) {
+            double n = double(N[l]);
+            Y[l] = sums[l].sumY / n;
+            V[l] = std::max(sums[l].sumY2 / n - Y[l] * Y[l], 0.0);
+            C[l] = l ? 1.5 * double(1 << l) : 1.0; // fine + coarse steps
+        }
+
+        // Decay rates from levels 1..L (weak order alpha, variance beta).
+        std::vector<double> ly, lv;
+        for (int l = 1; l <= L; l++) {
+            ly.push_back(std::log2(std::max(std::fabs(Y[l]), 1e-300)));
+            lv.push_back(std::log2(std::max(V[l], 1e-300)));
+        }
+        alpha = std::max(0.5, -level_slope(ly));
+        beta = std::max(0.5, -level_slope(lv));
+
+        auto allocate = [&](int upTo) {
+            double s = 0.0;
+            for (int l = 0; l <= upTo; l++) s += std::sqrt(V[l] * C[l]);
+            bool more = false;
+            for (int l = 0; l <= upTo; l++) {
+                double opt = std::ceil(2.0 / (eps * eps) * std::sqrt(V[l] / C[l]) * s);
+                dN[l] = opt > double(N[l]) ? ui64(opt) - N[l] : 0;
+                if (dN[l] > N[l] / 100) more = true;
+            }
+            return more;
+        };
+
+        if (allocate(L)) continue;
+
+        // Sample counts are settled: test the remaining bias.
+        double rem = std::max(std::fabs(Y[L]), std::fabs(Y[L - 1]) / std::pow(2.0, alpha))
+                   / (std::pow(2.0, alpha) - 1.0);
+        if (rem <= eps / std::sqrt(2.0)) {
+            converged = true;
+        } else if (L == MAX_LEVEL) {
+            std::cerr << "Warning: bias test not met at level " << MAX_LEVEL << "\n";
+            converged = true;
+        } else {
+            L++;
+            V[L] = V[L - 1] / std::pow(2.0, beta);
+            C[L] = 1.5 * double(1 << L);
+            allocate(L);
+            dN[L] = std::max<ui64>(dN[L], N0);
+        }
+    }
+
+    double t2 = dml_micros();
+
+    double value = 0.0, cost = 0.0;
+    for (int l = 0; l <= L; l++) {
+        value += Y[l];
+        cost += double(N[l]) * C[l];
+    }
+    double disc = std::exp(-p.r * p.T);
+    value *= disc;
+
+    // Plain Monte Carlo on the finest level at the same accuracy.
+    double nL = double(N[L]);
+    double mL = sums[L].sumP / nL;
+    double vL = std::max(sums[L].sumP2 / nL - mL * mL, 0.0);
+    double mcCost = 2.0 * vL / (eps * eps) * double(1 << L);
+
+    std::cout << "product= " << name << "   eps= " << eps
+              << "   alpha= " << std::setprecision(3) << alpha << "   beta= " << beta << "\n";
+    std::cout << " l        N_l        mean_l        var_l\n";
+    for (int l = 0; l <= L; l++) {
+        std::cout << std::setw(2) << l << std::setw(11) << N[l]
+                  << std::scientific << std::setprecision(4)
+                  << std::setw(14) << Y[l] * disc << std::setw(13) << V[l] * disc * disc
+                  << std::defaultfloat << "\n";
+    }
+    std::cout << std::scientific << std::setprecision(3)
+              << "cost mlmc= " << cost << " steps   plain mc= " << mcCost
+              << " steps   saving= " << std::fixed << std::setprecision(1) << mcCost / cost << "x\n";
+    if (product == EUROPEAN) {
+        std::cout << std::fixed << std::setprecision(6)
+                  << "closed form= " << bsm_price(p.S0, p.K, p.T, p.r, 0.0, p.sigma, 1) << "\n";
+    } else if (product == BARRIER) {
+        std::cout << std::fixed << std::setprecision(6)
+                  << "continuous barrier closed form= " << down_and_out_call(p) << "\n";
+    }
+
+    std::cout << std::fixed << std::setprecision(6)
+              << "value= " << value << " in " << (t2 - t1) * 1e-6 << " s\n";
+    return 0;
+}
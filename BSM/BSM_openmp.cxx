@@ -3,38 +3,14 @@
 #include <random>
 #include <algorithm>
 #include <iomanip>
-#include <sys/time.h>
 #include <omp.h>  // OpenMP
-
-#define ui64 uint64_t
-
-/*******************************************
- * @brief Returns the current time in microseconds.
- * 
- * @return Current time in microseconds.
- *******************************************/
-double dml_micros() {
-    static struct timezone tz;
-    static struct timeval  tv;
-    gettimeofday(&tv, &tz);
-    return (tv.tv_sec * 1000000.0) + tv.tv_usec;
-}
-
-/*******************************************
- * @brief Generates Gaussian noise using the Box-Muller transform.
- * 
- * @return Random Gaussian value.
- *******************************************/
-double gaussian_box_muller() {
-    static thread_local std::mt19937 generator(std::random_device{}());
-    static thread_local std::normal_distribution<double> distribution(0.0, 1.0);
-    return distribution(generator);
-}
+#include "BSM_kernels.h"
 
 /*******************************************
- * @brief Computes the Black-Scholes call option price using the Monte Carlo method.
+ * @brief Computes the Black-Scholes option price using the Monte Carlo method.
  *        This version uses loop unrolling and OpenMP for parallelization.
  *
+ * @tparam Payoff Payoff policy (call_payoff, put_payoff, digital_payoff).
  * @param S0 Initial stock price.
  * @param K Strike price.
  * @param T Time to maturity.
@@ -42,8 +18,9 @@ double gaussian_box_muller() {
  * @param sigma Volatility.
  * @param q Dividend yield.
  * @param num_simulations Number of Monte Carlo simulations.
- * @return Call option price.
+ * @return Option price.
  *******************************************/
+template <class Payoff>
 double black_scholes_monte_carlo_unroll_omp(
     ui64 S0, ui64 K, double T, double r, double sigma, double q, ui64 num_simulations)
 {
@@ -68,10 +45,10 @@ double black_scholes_monte_carlo_unroll_omp(
             double ST2 = S0 * std::exp(drift + vol * Z2);
             double ST3 = S0 * std::exp(drift + vol * Z3);
 
-            double payoff0 = (ST0 > K) ? (ST0 - K) : 0.0;
-            double payoff1 = (ST1 > K) ? (ST1 - K) : 0.0;
-            double payoff2 = (ST2 > K) ? (ST2 - K) : 0.0;
-            double payoff3 = (ST3 > K) ? (ST3 - K) : 0.0;
+            double payoff0 = Payoff::eval(ST0, K);
+            double payoff1 = Payoff::eval(ST1, K);
+            double payoff2 = Payoff::eval(ST2, K);
+            double payoff3 = Payoff::eval(ST3, K);
 
             sum_payoffs += (payoff0 + payoff1 + payoff2 + payoff3);
         }
@@ -80,7 +57,7 @@ double black_scholes_monte_carlo_unroll_omp(
         for (ui64 i = (num_simulations / 4) * 4; i < num_simulations; i++) {
             double Z = gaussian_box_muller();
             double ST = S0 * std::exp(drift + vol * Z);
-            double payoff = (ST > K) ? (ST - K) : 0.0;
+            double payoff = Payoff::eval(ST, K);
             sum_payoffs += payoff;
         }
     }
@@ -121,7 +98,7 @@ int main(int argc, char* argv[]) {
     double t1 = dml_micros();
     double sum = 0.0;
     for (ui64 run = 0; run < num_runs; ++run) {
-        sum += black_scholes_monte_carlo_unroll_omp(S0, K, T, r, sigma, q, num_simulations);
+        sum += black_scholes_monte_carlo_unroll_omp<call_payoff>(S0, K, T, r, sigma, q, num_simulations);
     }
     double t2 = dml_micros();
 
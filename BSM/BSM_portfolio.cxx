@@ -0,0 +1,416 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Columnar portfolio files and streaming pricing.
+
+    Usage: ./BSM_portfolio gen     <out.bin> <num_options>
+           ./BSM_portfolio csv2bin <in.csv> <out.bin>
+           ./BSM_portfolio bin2csv <in.bin> <out.csv>
+           ./BSM_portfolio price   <in.bin> <out.csv> <num_sims>   (0 = closed form)
+
+    CSV layout: S0,K,T,r,sigma,q,type   with type C or P, one header line.
+
+    The binary file is a 4 KiB header followed by one page-aligned array
+    per field, so it can be memory-mapped and read in place. Pricing walks
+    the mapping in windows; finished windows are released with
+    MADV_DONTNEED so books larger than RAM stream through. Results are
+    formatted and written by a separate thread while the next window is
+    priced.
+*/
+
+#define PF_MAGIC "BSMPF001"
+#define PF_FIELDS 7
+#define PF_PAGE 4096
+#define PF_WINDOW 65536
+
+enum pf_field { F_S0 = 0, F_K, F_T, F_R, F_SIGMA, F_Q, F_TYPE };
+
+/*******************************************
+ * @brief On-disk header of a portfolio file.
+ *******************************************/
+struct pf_header {
+    char magic[8];
+    ui64 count;
+    ui64 nFields;
+    ui64 offset[PF_FIELDS];
+};
+
+/*******************************************
+ * @brief Memory-mapped view of a portfolio file.
+ *
+ * Columns are typed pointers straight into the mapping (zero copy).
+ *******************************************/
+struct pf_view {
+    int fd = -1;
+    size_t bytes = 0;
+    char *base = nullptr;
+    ui64 count = 0;
+    double *col[PF_FIELDS - 1] = {};
+    uint8_t *isCall = nullptr;
+
+    ~pf_view() {
+        if (base) munmap(base, bytes);
+        if (fd >= 0) close(fd);
+    }
+};
+
+static ui64 pf_align(ui64 x) { return (x + PF_PAGE - 1) / PF_PAGE * PF_PAGE; }
+
+/*******************************************
+ * @brief Builds the header for a given option count.
+ *
+ * @return Total file size.
+ *******************************************/
+static ui64 pf_layout(ui64 count, pf_header &h) {
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, PF_MAGIC, 8);
+    h.count = count;
+    h.nFields = PF_FIELDS;
+    ui64 off = PF_PAGE;
+    for (int f = 0; f < PF_FIELDS; f++) {
+        h.offset[f] = off;
+        off = pf_align(off + count * (f == F_TYPE ? 1 : sizeof(double)));
+    }
+    return off;
+}
+
+static void pf_bind(pf_view &v, const pf_header &h) {
+    v.count = h.count;
+    for (int f = 0; f < PF_FIELDS - 1; f++) v.col[f] = reinterpret_cast<double*>(v.base + h.offset[f]);
+    v.isCall = reinterpret_cast<uint8_t*>(v.base + h.offset[F_TYPE]);
+}
+
+/*******************************************
+ * @brief Creates a portfolio file of the given size and maps it writable.
+ *******************************************/
+static bool pf_create(const char *path, ui64 count, pf_view &v) {
+    pf_header h;
+    v.bytes = pf_layout(count, h);
+    v.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (v.fd < 0 || ftruncate(v.fd, off_t(v.bytes)) != 0) return false;
+    void *p = mmap(nullptr, v.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, v.fd, 0);
+    if (p == MAP_FAILED) return false;
+    v.base = static_cast<char*>(p);
+    std::memcpy(v.base, &h, sizeof(h));
+    pf_bind(v, h);
+    return true;
+}
+
+/*******************************************
+ * @brief Maps an existing portfolio file read-only.
+ *******************************************/
+static bool pf_open(const char *path, pf_view &v) {
+    v.fd = open(path, O_RDONLY);
+    struct stat st;
+    if (v.fd < 0 || fstat(v.fd, &st) != 0 || size_t(st.st_size) < sizeof(pf_header)) return false;
+    v.bytes = size_t(st.st_size);
+    void *p = mmap(nullptr, v.bytes, PROT_READ, MAP_SHARED, v.fd, 0);
+    if (p == MAP_FAILED) return false;
+    v.base = static_cast<char*>(p);
+    pf_header h;
+    std::memcpy(&h, v.base, sizeof(h));
+    if (std::memcmp(h.magic, PF_MAGIC, 8) != 0 || h.nFields != PF_FIELDS) return false;
+    // Every column is at most bytes long, so a larger count is corrupt
+    // (and would overflow the layout computation).
+    if (h.count > v.bytes / sizeof(double)) return false;
+    pf_header expect;
+    if (pf_layout(h.count, expect) > v.bytes) return false;
+    for (int f = 0; f < PF_FIELDS; f++)
+        if (h.offset[f] != expect.offset[f]) return false;
+    pf_bind(v, expect);
+    madvise(v.base, v.bytes, MADV_SEQUENTIAL);
+    return true;
+}
+
+/*******************************************
+ * @brief Writes a random portfolio straight into a new file.
+ *******************************************/
+static int cmd_gen(const char *out, ui64 n) {
+    pf_view v;
+    if (!pf_create(out, n, v)) { std::perror(out); return 1; }
+    #pragma omp parallel
+    {
+        xorshift128plus_state rng;
+        #pragma omp for schedule(static, PF_WINDOW)
+        for (ui64 i = 0; i < n; i++) {
+            xorshift128plus_init(rng, 0x5EED0000ULL ^ (0x9E3779B97F4A7C15ULL * (i + 1)));
+            v.col[F_S0][i] = 100.0;
+            v.col[F_K][i] = 80.0 + 40.0 * uniform01(rng);
+            v.col[F_T][i] = 0.1 + 2.9 * uniform01(rng);
+            v.col[F_R][i] = 0.06 * uniform01(rng);
+            v.col[F_SIGMA][i] = 0.1 + 0.4 * uniform01(rng);
+            v.col[F_Q][i] = 0.03 * uniform01(rng);
+            v.isCall[i] = uint8_t(xorshift128plus(rng) >> 63);
+        }
+    }
+    msync(v.base, v.bytes, MS_SYNC);
+    std::cout << "wrote " << n << " options to " << out << "\n";
+    return 0;
+}
+
+/*******************************************
+ * @brief Whether fgets returned a whole line (not one cut at the buffer size).
+ *******************************************/
+static bool csv_line_complete(const char *line, FILE *f) {
+    size_t len = std::strlen(line);
+    if (len > 0 && line[len - 1] == '\n') return true;
+    int c = std::fgetc(f);
+    if (c == EOF) return true;
+    std::ungetc(c, f);
+    return false;
+}
+
+/*******************************************
+ * @brief Converts CSV to the columnar format in two streaming passes.
+ *
+ * The first pass counts rows so the output can be sized and mapped; the
+ * second parses straight into the mapped columns.
+ *******************************************/
+static int cmd_csv2bin(const char *in, const char *out) {
+    FILE *f = std::fopen(in, "r");
+    if (!f) { std::perror(in); return 1; }
+    char line[512];
+    ui64 n = 0;
+    if (!std::fgets(line, sizeof(line), f)) { std::fclose(f); return 1; }
+    for (ui64 row = 2; std::fgets(line, sizeof(line), f); row++) {
+        if (!csv_line_complete(line, f)) {
+            std::cerr << "Row " << row << " is longer than " << sizeof(line) - 2 << " characters\n";
+            std::fclose(f);
+            return 1;
+        }
+        if (line[0] != '\n') n++;
+    }
+
+    pf_view v;
+    if (!pf_create(out, n, v)) { std::perror(out); std::fclose(f); return 1; }
+    std::rewind(f);
+    (void)!std::fgets(line, sizeof(line), f);
+    ui64 i = 0;
+    while (i < n && std::fgets(line, sizeof(line), f)) {
+        if (line[0] == '\n') continue;
+        char type = 'C';
+        int got = std::sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%c",
+                              &v.col[F_S0][i], &v.col[F_K][i], &v.col[F_T][i], &v.col[F_R][i],
+                              &v.col[F_SIGMA][i], &v.col[F_Q][i], &type);
+        if (got < 6) {
+            std::cerr << "Malformed row " << i + 2 << ": " << line;
+            std::fclose(f);
+            return 1;
+        }
+        v.isCall[i] = (type == 'P' || type == 'p') ? 0 : 1;
+        i++;
+    }
+    std::fclose(f);
+    msync(v.base, v.bytes, MS_SYNC);
+    std::cout << "converted " << n << " options to " << out << "\n";
+    return 0;
+}
+
+/*******************************************
+ * @brief Converts a columnar file back to CSV.
+ *******************************************/
+static int cmd_bin2csv(const char *in, const char *out) {
+    pf_view v;
+    if (!pf_open(in, v)) { std::cerr << in << ": not a portfolio file\n"; return 1; }
+    FILE *f = std::fopen(out, "w");
+    if (!f) { std::perror(out); return 1; }
+    std::fprintf(f, "S0,K,T,r,sigma,q,type\n");
+    for (ui64 i = 0; i < v.count; i++) {
+        std::fprintf(f, "%.17g,%.17g,%.17g,%.17g,%.17g,%.17g,%c\n",
+                     v.col[F_S0][i], v.col[F_K][i], v.col[F_T][i], v.col[F_R][i],
+                     v.col[F_SIGMA][i], v.col[F_Q][i], v.isCall[i] ? 'C' : 'P');
+    }
+    std::fclose(f);
+    return 0;
+}
+
+/*******************************************
+ * @brief Monte Carlo price of one option (single thread).
+ *
+ * @param se Output standard error.
+ *******************************************/
+static double price_mc(double S0, double K, double T, double r, double sigma,
+                       double q, int isCall, ui64 nSim, ui64 seed, double &se) {
+    double drift = (r - q - 0.5 * sigma * sigma) * T;
+    double vol = sigma * std::sqrt(T);
+    double w = isCall ? 1.0 : -1.0;
+    xorshift128plus_state rng;
+    xorshift128plus_init(rng, 0xDEADBEEF ^ (0x9E3779B97F4A7C15ULL * (seed + 1)));
+
+    const int CHUNK = 256;
+    double g[CHUNK];
+    double sum = 0.0, sumSq = 0.0;
+    for (ui64 done = 0; done < nSim; done += CHUNK) {
+        int cnt = int(std::min<ui64>(CHUNK, nSim - done));
+        normal_block(rng, g, cnt);
+        #pragma omp simd reduction(+:sum, sumSq)
+        for (int i = 0; i < cnt; i++) {
+            double ST = S0 * std::exp(drift + vol * g[i]);
+            double pay = std::max(w * (ST - K), 0.0);
+            sum += pay;
+            sumSq += pay * pay;
+        }
+    }
+    double disc = std::exp(-r * T);
+    double mean = sum / double(nSim);
+    se = disc * std::sqrt(std::max(sumSq / double(nSim) - mean * mean, 0.0) / double(nSim));
+    return disc * mean;
+}
+
+/*******************************************
+ * @brief Result window handed from the pricing loop to the writer thread.
+ *******************************************/
+struct result_chunk {
+    ui64 first = 0;
+    ui64 count = 0;
+    std::vector<double> price, se;
+    bool full = false;
+};
+
+/*******************************************
+ * @brief Prices a mapped portfolio and streams results to CSV.
+ *
+ * Two result buffers alternate: while the writer formats window k, the
+ * workers price window k+1 into the other buffer.
+ *******************************************/
+static int cmd_price(const char *in, const char *out, ui64 nSim) {
+    pf_view v;
+    if (!pf_open(in, v)) { std::cerr << in << ": not a portfolio file\n"; return 1; }
+    FILE *f = std::fopen(out, "w");
+    if (!f) { std::perror(out); return 1; }
+    std::fprintf(f, "id,price,std_error\n");
+
+    result_chunk buf[2];
+    for (auto &b : buf) { b.price.resize(PF_WINDOW); b.se.resize(PF_WINDOW); }
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    double checksum = 0.0;
+
+    std::thread writer([&] {
+        std::vector<char> text(size_t(PF_WINDOW) * 64);
+        char line[1024]; // Two %.6f of DBL_MAX plus the id fit.
+        for (int k = 0;; k ^= 1) {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [&] { return buf[k].full || done; });
+            if (!buf[k].full) break;
+            lk.unlock();
+            size_t len = 0;
+            for (ui64 i = 0; i < buf[k].count; i++) {
+                int n = std::snprintf(line, sizeof(line), "%llu,%.6f,%.6f\n",
+                                      (unsigned long long)(buf[k].first + i),
+                                      buf[k].price[i], buf[k].se[i]);
+                size_t w = std::min(size_t(n), sizeof(line) - 1);
+                if (len + w > text.size()) {
+                    std::fwrite(text.data(), 1, len, f);
+                    len = 0;
+                }
+                std::memcpy(text.data() + len, line, w);
+                len += w;
+                checksum += buf[k].price[i];
+            }
+            std::fwrite(text.data(), 1, len, f);
+            lk.lock();
+            buf[k].full = false;
+            cv.notify_all();
+        }
+    });
+
+    double t1 = dml_micros();
+    int k = 0;
+    for (ui64 first = 0; first < v.count; first += PF_WINDOW, k ^= 1) {
+        ui64 cnt = std::min<ui64>(PF_WINDOW, v.count - first);
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [&] { return !buf[k].full; });
+        }
+        result_chunk &b = buf[k];
+        const double *S0 = v.col[F_S0] + first, *K = v.col[F_K] + first;
+        const double *T = v.col[F_T] + first, *r = v.col[F_R] + first;
+        const double *sig = v.col[F_SIGMA] + first, *q = v.col[F_Q] + first;
+        const uint8_t *isCall = v.isCall + first;
+
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (ui64 i = 0; i < cnt; i++) {
+            if (nSim == 0) {
+                b.price[i] = bsm_price(S0[i], K[i], T[i], r[i], q[i], sig[i], isCall[i]);
+                b.se[i] = 0.0;
+            } else {
+                b.price[i] = price_mc(S0[i], K[i], T[i], r[i], sig[i], q[i], isCall[i],
+                                      nSim, first + i, b.se[i]);
+            }
+        }
+
+        // Pages behind the window are not needed any more.
+        for (int fld = 0; fld < PF_FIELDS; fld++) {
+            char *col = (fld == F_TYPE) ? reinterpret_cast<char*>(v.isCall)
+                                        : reinterpret_cast<char*>(v.col[fld]);
+            size_t width = (fld == F_TYPE) ? 1 : sizeof(double);
+            size_t start = size_t(col - v.base);
+            size_t end = start + (first + cnt) * width;
+            size_t lo = pf_align(start), hi = end / PF_PAGE * PF_PAGE;
+            if (hi > lo) madvise(v.base + lo, hi - lo, MADV_DONTNEED);
+        }
+
+        std::lock_guard<std::mutex> lk(m);
+        b.first = first;
+        b.count = cnt;
+        b.full = true;
+        cv.notify_all();
+    }
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv.wait(lk, [&] { return !buf[0].full && !buf[1].full; });
+        done = true;
+        cv.notify_all();
+    }
+    writer.join();
+    std::fclose(f);
+    double t2 = dml_micros();
+
+    double elapsed = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(6)
+              << "Portfolio => value= " << checksum / double(v.count ? v.count : 1)
+              << " in " << elapsed << " s   (" << v.count << " options, "
+              << double(v.count) / elapsed << " options/s)\n";
+    return 0;
+}
+
+/*******************************************
+ * @brief Main function: dispatches the sub-commands.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    std::string cmd = (argc > 1) ? argv[1] : "";
+    if (cmd == "gen" && argc == 4) return cmd_gen(argv[2], std::stoull(argv[3]));
+    if (cmd == "csv2bin" && argc == 4) return cmd_csv2bin(argv[2], argv[3]);
+    if (cmd == "bin2csv" && argc == 4) return cmd_bin2csv(argv[2], argv[3]);
+    if (cmd == "price" && argc == 5) return cmd_price(argv[2], argv[3], std::stoull(argv[4]));
+
+    std::cerr << "Usage: " << argv[0] << " gen <out.bin> <num_options>\n"
+              << "       " << argv[0] << " csv2bin <in.csv> <out.bin>\n"
+              << "       " << argv[0] << " bin2csv <in.bin> <out.csv>\n"
+              << "       " << argv[0] << " price <in.bin> <out.csv> <num_sims>\n";
+    return 1;
+}
@@ -0,0 +1,277 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+namespace py = pybind11;
+
+/*
+    Python bindings for batched pricing (module "bsm").
+
+    Build: see compile.sh (produces bsm<python extension suffix>.so)
+
+        import numpy as np, bsm
+        n = 1_000_000
+        S0 = np.full(n, 100.0); K = np.linspace(80, 120, n)
+        T = np.ones(n); r = np.full(n, 0.06); sigma = np.full(n, 0.2)
+        price = bsm.price(S0, K, T, r, sigma, backend="analytic")
+        price, se = bsm.price(S0, K, T, r, sigma, num_sims=10000,
+                              backend="mc", return_stderr=True)
+
+    Inputs must be contiguous float64 arrays of the same length (is_call:
+    bool or uint8); they are read in place, never copied, and a TypeError
+    is raised rather than silently converting. Results go to freshly
+    allocated arrays or to caller-provided "out"/"stderr_out" arrays.
+    The GIL is released while pricing, so other Python threads keep
+    running.
+
+    Backends:
+        analytic   closed-form Black-Scholes-Merton
+        mc         Monte Carlo, BSM_final --model exact
+        mc_fast    Monte Carlo, BSM_final's default exp_approx_clamp model
+    Both Monte Carlo backends run BSM_final's generator, policies and
+    block_payoff_sum from BSM_kernels.h. num_sims is rounded up to whole
+    blocks of CHUNK paths (at least two), and the standard error is taken
+    over the block means.
+
+    bsm_smoke.py checks that the module imports and that mc agrees with
+    analytic; compile.sh runs it after building the module.
+*/
+
+#define CHUNK 256
+
+/*******************************************
+ * @brief Read-only view of one batch, as raw column pointers.
+ *
+ * q and isCall may be null (no dividend, calls).
+ *******************************************/
+struct batch_view {
+    const double *S0, *K, *T, *r, *sigma, *q;
+    const uint8_t *isCall;
+    size_t n;
+};
+
+enum class backend_kind { analytic, mc, mc_fast };
+
+/*******************************************
+ * @brief Closed-form prices of a batch.
+ *
+ * @param b Batch.
+ * @param price Output prices.
+ * @param nThreads Worker count.
+ *******************************************/
+static void price_analytic(const batch_view &b, double *price, int nThreads) {
+    #pragma omp parallel for simd schedule(static) num_threads(nThreads)
+    for (size_t i = 0; i < b.n; i++) {
+        double q = b.q ? b.q[i] : 0.0;
+        bool call = !b.isCall || b.isCall[i];
+        price[i] = bsm_price(b.S0[i], b.K[i], b.T[i], b.r[i], q, b.sigma[i], call);
+    }
+}
+
+/*******************************************
+ * @brief Monte Carlo price of one option with BSM_final's kernel.
+ *
+ * The dividend yield enters the model through the drift rate r - q;
+ * the payoff is discounted at r.
+ *
+ * @tparam Payoff Payoff policy.
+ * @tparam Model Model policy.
+ * @param S0 Initial stock price.
+ * @param K Strike price.
+ * @param T Time to maturity.
+ * @param r Risk-free interest rate.
+ * @param q Dividend yield.
+ * @param sigma Volatility.
+ * @param nBlocks Number of CHUNK-path blocks.
+ * @param seed Generator seed of this option.
+ * @param price Output price.
+ * @param stdErr Output standard error (may be null).
+ *******************************************/
+template <class Payoff, class Model>
+static void price_one_mc(double S0, double K, double T, double r, double q, double sigma,
+                         ui64 nBlocks, ui64 seed, double *price, double *stdErr) {
+    const Model model(S0, T, r - q, sigma);
+    xorshift_uniform_rng rng;
+    rng.seed(seed);
+    alignas(64) double u1[CHUNK], u2[CHUNK];
+
+    double sum = 0.0, sumSq = 0.0;
+    for (ui64 b = 0; b < nBlocks; b++) {
+        for (int j = 0; j < CHUNK; j++) {
+            u1[j] = rng.next();
+            u2[j] = rng.next();
+        }
+        double mean = block_payoff_sum<Payoff>(model, K, u1, u2, CHUNK) / CHUNK;
+        sum += mean;
+        sumSq += mean * mean;
+    }
+
+    double N = double(nBlocks);
+    double mean = sum / N;
+    double var = std::max(sumSq / N - mean * mean, 0.0) * N / (N - 1.0);
+    double disc = std::exp(-r * T);
+    *price = disc * mean;
+    if (stdErr) *stdErr = disc * std::sqrt(var / N);
+}
+
+/*******************************************
+ * @brief Monte Carlo prices of a batch, one option per task.
+ *
+ * Option i is seeded from (seed, i), so a price does not depend on the
+ * thread count nor on the other options of the batch.
+ *
+ * @tparam Model Model policy.
+ * @param b Batch.
+ * @param nSim Paths per option.
+ * @param seed Base seed.
+ * @param price Output prices.
+ * @param stdErr Output standard errors (may be null).
+ * @param nThreads Worker count.
+ *******************************************/
+template <class Model>
+static void price_mc(const batch_view &b, ui64 nSim, ui64 seed,
+                     double *price, double *stdErr, int nThreads) {
+    const ui64 nBlocks = std::max<ui64>(2, (nSim + CHUNK - 1) / CHUNK);
+
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(nThreads)
+    for (size_t i = 0; i < b.n; i++) {
+        double q = b.q ? b.q[i] : 0.0;
+        ui64 s = seed_mix(0xDEADBEEF ^ (0xA5ULL * (seed + 1)) ^ (0x9E37ULL * (ui64(i) + 1)));
+        double *se = stdErr ? stdErr + i : nullptr;
+        if (!b.isCall || b.isCall[i])
+            price_one_mc<call_payoff, Model>(b.S0[i], b.K[i], b.T[i], b.r[i], q, b.sigma[i],
+                                            nBlocks, s, price + i, se);
+        else
+            price_one_mc<put_payoff, Model>(b.S0[i], b.K[i], b.T[i], b.r[i], q, b.sigma[i],
+                                           nBlocks, s, price + i, se);
+    }
+}
+
+static int g_threads = 0; // 0: OpenMP default
+
+using darray = py::array_t<double, py::array::c_style>;
+
+static int effective_threads() {
+    return g_threads > 0 ? g_threads : omp_get_max_threads();
+}
+
+static backend_kind parse_backend(const std::string &name) {
+    if (name == "analytic") return backend_kind::analytic;
+    if (name == "mc") return backend_kind::mc;
+    if (name == "mc_fast") return backend_kind::mc_fast;
+    throw py::value_error("unknown backend '" + name + "' (see bsm.backends())");
+}
+
+/*******************************************
+ * @brief Checks one input column and returns its data pointer.
+ *******************************************/
+template <class A>
+static auto column(const A &a, size_t n, const char *name) {
+    if (a.ndim() != 1 || size_t(a.shape(0)) != n) {
+        throw py::value_error(std::string(name) + " must be 1-D with the length of S0");
+    }
+    return a.data();
+}
+
+/*******************************************
+ * @brief Returns a writable output column, allocating it if needed.
+ *******************************************/
+static darray output(py::object out, size_t n, const char *name) {
+    if (out.is_none()) return darray(n);
+    if (!darray::check_(out)) {
+        throw py::type_error(std::string(name) + " must be a contiguous float64 array");
+    }
+    darray a = py::reinterpret_borrow<darray>(out);
+    if (a.ndim() != 1 || size_t(a.shape(0)) != n || !a.writeable()) {
+        throw py::value_error(std::string(name) + " must be a writable 1-D array with the length of S0");
+    }
+    return a;
+}
+
+/*******************************************
+ * @brief bsm.price(): prices a batch in place, GIL released.
+ *******************************************/
+static py::object py_price(darray S0, darray K, darray T, darray r, darray sigma,
+                           std::optional<darray> q, std::optional<py::array> isCall,
+                           ui64 nSim, const std::string &backendName, ui64 seed,
+                           bool returnStderr, py::object out, py::object stderrOut) {
+    backend_kind backend = parse_backend(backendName);
+    if (backend != backend_kind::analytic && nSim == 0) {
+        throw py::value_error("num_sims must be positive for Monte Carlo backends");
+    }
+
+    size_t n = size_t(S0.size());
+    batch_view b;
+    b.n = n;
+    b.S0 = column(S0, n, "S0");
+    b.K = column(K, n, "K");
+    b.T = column(T, n, "T");
+    b.r = column(r, n, "r");
+    b.sigma = column(sigma, n, "sigma");
+    b.q = q ? column(*q, n, "q") : nullptr;
+    b.isCall = nullptr;
+    if (isCall) {
+        char kind = isCall->dtype().kind();
+        if (isCall->itemsize() != 1 || (kind != 'b' && kind != 'u' && kind != 'i')
+            || !(isCall->flags() & py::array::c_style)) {
+            throw py::type_error("is_call must be a contiguous bool or uint8 array");
+        }
+        b.isCall = static_cast<const uint8_t*>(column(*isCall, n, "is_call"));
+    }
+
+    darray price = output(out, n, "out");
+    darray se;
+    bool wantSe = returnStderr || !stderrOut.is_none();
+    if (wantSe) se = output(stderrOut, n, "stderr_out");
+    double *pp = price.mutable_data();
+    double *ps = wantSe ? se.mutable_data() : nullptr;
+    int nThreads = effective_threads();
+
+    {
+        py::gil_scoped_release nogil;
+        switch (backend) {
+        case backend_kind::analytic:
+            price_analytic(b, pp, nThreads);
+            if (ps) std::fill(ps, ps + n, 0.0);
+            break;
+        case backend_kind::mc:
+            price_mc<exact_gbm_model>(b, nSim, seed, pp, ps, nThreads);
+            break;
+        case backend_kind::mc_fast:
+            price_mc<approx_gbm_model>(b, nSim, seed, pp, ps, nThreads);
+            break;
+        }
+    }
+
+    if (returnStderr) return py::make_tuple(price, se);
+    return price;
+}
+
+PYBIND11_MODULE(bsm, m) {
+    m.doc() = "Batched Black-Scholes-Merton pricing (closed form and Monte Carlo).";
+
+    m.def("price", &py_price,
+          py::arg("S0").noconvert(), py::arg("K").noconvert(), py::arg("T").noconvert(),
+          py::arg("r").noconvert(), py::arg("sigma").noconvert(),
+          py::arg("q").noconvert() = py::none(), py::arg("is_call").noconvert() = py::none(),
+          py::arg("num_sims") = 0, py::arg("backend") = "analytic", py::arg("seed") = 0,
+          py::arg("return_stderr") = false,
+          py::arg("out") = py::none(), py::arg("stderr_out") = py::none(),
+          "Prices a batch of European options. Inputs are contiguous float64 arrays\n"
+          "(is_call: uint8/bool) read without copying; returns the prices, or\n"
+          "(prices, std_errors) with return_stderr=True.");
+
+    m.def("set_num_threads", [](int n) { g_threads = std::max(0, n); }, py::arg("n"),
+          "Sets the worker count (0 restores the OpenMP default).");
+    m.def("get_num_threads", &effective_threads, "Worker count used by price().");
+    m.def("backends", [] { return std::vector<std::string>{"analytic", "mc", "mc_fast"}; },
+          "Names accepted by price(backend=...).");
+}
@@ -0,0 +1,225 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Scenario grid revaluation with common random numbers.
+
+    Usage: ./BSM_scenario <num_sims> [pnl.csv]
+
+    Revalues the call (K=110, T=1) on a spot x vol x rate grid:
+        spot  100 * (1 + k * 4%), k = -5..5      (11 points)
+        vol   0.10 .. 0.40 step 0.05             (7 points)
+        rate  0.02 .. 0.10 step 0.02             (5 points)
+    Every block of normals is generated once and each normal is applied
+    to all scenarios in a SIMD loop running across the scenario arrays.
+    Because all scenarios see the same draws, the P&L against the base
+    scenario (S0=100, sigma=0.2, r=0.06) is estimated from per-path
+    differences; its standard error is printed next to the one
+    independent runs would give.
+
+    CSV columns: spot,vol,rate,price,price_se,pnl,pnl_se
+*/
+
+#define CHUNK 256
+
+/*******************************************
+ * @brief Scenario grid in SoA form, padded to a multiple of 8.
+ *
+ * Per scenario: the inputs and the per-path constants
+ * (S0 e^{-rT}, drift, vol, K e^{-rT}) so the inner loop is one exp,
+ * one fma chain and one max.
+ *******************************************/
+struct scenario_grid {
+    int n;          // real scenarios
+    int padded;     // n rounded up to 8
+    int base;       // index of the base scenario
+    std::vector<double> spot, vol, rate;
+    std::vector<double> fwdDisc, drift, sigT, kDisc;
+
+    void build(double K, double T) {
+        for (int k = -5; k <= 5; k++)
+            for (int v = 0; v < 7; v++)
+                for (int r = 0; r < 5; r++) {
+                    if (k == 0 && v == 2 && r == 2) base = int(spot.size());
+                    spot.push_back(100.0 * (1.0 + 0.04 * k));
+                    vol.push_back(0.10 + 0.05 * v);
+                    rate.push_back(0.02 + 0.02 * r);
+                }
+        n = int(spot.size());
+        padded = (n + 7) & ~7;
+        fwdDisc.assign(padded, 0.0);
+        drift.assign(padded, 0.0);
+        sigT.assign(padded, 0.0);
+        kDisc.assign(padded, 0.0);
+        for (int s = 0; s < n; s++) {
+            double disc = std::exp(-rate[s] * T);
+            fwdDisc[s] = spot[s] * disc;
+            drift[s] = (rate[s] - 0.5 * vol[s] * vol[s]) * T;
+            sigT[s] = vol[s] * std::sqrt(T);
+            kDisc[s] = K * disc;
+        }
+    }
+};
+
+/*******************************************
+ * @brief Per-scenario sums: price, its square, P&L vs base and its square.
+ *******************************************/
+struct scenario_sums {
+    std::vector<double> sum, sumSq, sumD, sumD2;
+
+    void init(int n) {
+        sum.assign(n, 0.0);
+        sumSq.assign(n, 0.0);
+        sumD.assign(n, 0.0);
+        sumD2.assign(n, 0.0);
+    }
+};
+
+/*******************************************
+ * @brief Revalues the grid over nSim paths.
+ *
+ * Threads keep private sums (their own allocation, padded to cache
+ * lines); they are merged in thread order at the end.
+ *
+ * @param G Scenario grid.
+ * @param nSim Number of paths (rounded up to CHUNK).
+ * @param out Output sums.
+ *******************************************/
+static void revalue_grid(const scenario_grid &G, ui64 nSim, scenario_sums &out) {
+    const ui64 nBlocks = (nSim + CHUNK - 1) / CHUNK;
+    const int P = G.padded;
+    const int nThreads = omp_get_max_threads();
+    std::vector<scenario_sums> part(nThreads);
+
+    #pragma omp parallel num_threads(nThreads)
+    {
+        int t = omp_get_thread_num();
+        scenario_sums &acc = part[t];
+        acc.init(P + 8);
+        alignas(64) double g[CHUNK];
+        std::vector<double> payBuf(P + 8);
+        double *pay = payBuf.data();
+        const double *fd = G.fwdDisc.data(), *dr = G.drift.data();
+        const double *sg = G.sigT.data(), *kd = G.kDisc.data();
+        double *sum = acc.sum.data(), *sumSq = acc.sumSq.data();
+        double *sumD = acc.sumD.data(), *sumD2 = acc.sumD2.data();
+
+        #pragma omp for schedule(static)
+        for (ui64 b = 0; b < nBlocks; b++) {
+            xorshift128plus_state rng;
+            xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0x9E37ULL * (b + 1))));
+            normal_block(rng, g, CHUNK);
+
+            for (int i = 0; i < CHUNK; i++) {
+                const double z = g[i];
+                #pragma omp simd
+                for (int s = 0; s < P; s++) {
+                    double p = std::max(fd[s] * std::exp(dr[s] + sg[s] * z) - kd[s], 0.0);
+                    pay[s] = p;
+                    sum[s] += p;
+                    sumSq[s] += p * p;
+                }
+                const double pb = pay[G.base];
+                #pragma omp simd
+                for (int s = 0; s < P; s++) {
+                    double d = pay[s] - pb;
+                    sumD[s] += d;
+                    sumD2[s] += d * d;
+                }
+            }
+        }
+    }
+
+    out.init(G.n);
+    for (int t = 0; t < nThreads; t++) {
+        for (int s = 0; s < G.n; s++) {
+            out.sum[s] += part[t].sum[s];
+            out.sumSq[s] += part[t].sumSq[s];
+            out.sumD[s] += part[t].sumD[s];
+            out.sumD2[s] += part[t].sumD2[s];
+        }
+    }
+}
+
+/*******************************************
+ * @brief Main function: grid revaluation and P&L report.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <num_sims> [pnl.csv]\n";
+        return 1;
+    }
+    ui64 nSim = std::stoull(argv[1]);
+    std::string csvPath = (argc > 2) ? argv[2] : "scenario_pnl.csv";
+    const double K = 110.0, T = 1.0;
+
+    scenario_grid G;
+    G.build(K, T);
+    scenario_sums S;
+
+    double t1 = dml_micros();
+    revalue_grid(G, nSim, S);
+    double t2 = dml_micros();
+
+    double N = double((nSim + CHUNK - 1) / CHUNK * CHUNK);
+    std::vector<double> price(G.n), priceSe(G.n), pnl(G.n), pnlSe(G.n);
+    for (int s = 0; s < G.n; s++) {
+        price[s] = S.sum[s] / N;
+        priceSe[s] = std::sqrt(std::max(S.sumSq[s] / N - price[s] * price[s], 0.0) / N);
+        pnl[s] = S.sumD[s] / N;
+        pnlSe[s] = std::sqrt(std::max(S.sumD2[s] / N - pnl[s] * pnl[s], 0.0) / N);
+    }
+
+    std::ofstream csv(csvPath);
+    csv << "spot,vol,rate,price,price_se,pnl,pnl_se\n" << std::setprecision(10);
+    for (int s = 0; s < G.n; s++) {
+        csv << G.spot[s] << "," << G.vol[s] << "," << G.rate[s] << "," << price[s] << ","
+            << priceSe[s] << "," << pnl[s] << "," << pnlSe[s] << "\n";
+    }
+    csv.close();
+
+    // Median over the grid of the P&L error, CRN vs independent runs.
+    std::vector<double> crn, indep;
+    int worst = G.base;
+    for (int s = 0; s < G.n; s++) {
+        if (s == G.base) continue;
+        crn.push_back(pnlSe[s]);
+        indep.push_back(std::sqrt(priceSe[s] * priceSe[s] + priceSe[G.base] * priceSe[G.base]));
+        if (pnl[s] < pnl[worst]) worst = s;
+    }
+    std::nth_element(crn.begin(), crn.begin() + crn.size() / 2, crn.end());
+    std::nth_element(indep.begin(), indep.begin() + indep.size() / 2, indep.end());
+
+    double elapsed = (t2 - t1) * 1e-6;
+    std::cout << std::fixed << std::setprecision(6)
+              << "scenarios= " << G.n << "   paths= " << ui64(N)
+              << "   base price= " << price[G.base] << " +- " << priceSe[G.base] << "\n"
+              << "median pnl se: crn= " << crn[crn.size() / 2]
+              << "   independent runs= " << indep[indep.size() / 2] << "\n"
+              << "worst scenario: spot= " << std::setprecision(2) << G.spot[worst]
+              << " vol= " << G.vol[worst] << " rate= " << G.rate[worst]
+              << std::setprecision(6) << "   pnl= " << pnl[worst] << " +- " << pnlSe[worst] << "\n"
+              << "scenario evaluations/s= " << std::scientific << std::setprecision(3)
+              << N * G.n / elapsed << "\n"
+              << "grid written to " << csvPath << "\n";
+
+    std::cout << std::fixed << std::setprecision(6)
+              << "value= " << price[G.base] << " in " << elapsed << " s\n";
+    return 0;
+}
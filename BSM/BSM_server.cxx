@@ -0,0 +1,534 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Pricing daemon: keeps the OpenMP team and the per-thread buffers alive
+    and prices requests in batches.
+
+    Usage: ./BSM_server <socket_path | -> [max_batch] [window_us]
+
+    With "-" requests are read from stdin and answered on stdout, otherwise
+    the server listens on a Unix domain socket (see BSM_loadgen.cxx).
+
+    Request line : <id> <C|P> <S0> <K> <T> <r> <sigma> <q> <num_sims>
+    Response line: <id> <price> <std_error>
+
+    S0, K, T and sigma must be positive, r and q finite, and num_sims in
+    [1, MAX_SIMS]; any other line is answered with "error malformed
+    request".
+
+    Requests arriving within window_us of the first one of a batch (up to
+    max_batch of them) are priced together: each block of normals is
+    generated once and reused for every request of the batch.
+
+    Socket clients are non-blocking: the batcher appends the replies to
+    the client's output buffer and the poll loop sends them, so a client
+    that stops reading never holds up the others. A client with more
+    than MAX_BACKLOG unsent bytes is disconnected.
+*/
+
+#define CHUNK 256
+#define MAX_SIMS 100000000ULL // Keeps one request from stalling the batcher.
+#define MAX_BACKLOG (1 << 20)  // Unsent reply bytes before a client is dropped.
+
+/*******************************************
+ * @brief Client connection, shared by the reader and pending requests.
+ *
+ * The descriptor is closed when the last pending request releases it,
+ * so a client hanging up never invalidates an in-flight batch. outbuf
+ * holds replies not yet sent to a socket client (guarded by outMutex).
+ *******************************************/
+struct connection {
+    int fd;
+    bool owned;
+    std::string inbuf;
+    std::mutex outMutex;
+    std::string outbuf;
+    bool dropped = false;       // backlog exceeded, under outMutex
+    bool readClosed = false;    // reader side only
+
+    connection(int f, bool o) : fd(f), owned(o) {}
+    ~connection() { if (owned) close(fd); }
+};
+
+// Self-pipe waking the socket poll loop when replies are queued.
+static int g_wake[2] = {-1, -1};
+
+/*******************************************
+ * @brief One pricing request.
+ *
+ * Malformed lines are queued too, so their error reply goes out with
+ * the batch, through the same write as the priced answers.
+ *******************************************/
+struct pricing_request {
+    std::shared_ptr<connection> conn;
+    bool malformed = false;
+    std::string id;
+    int isCall;
+    double S0, K, T, r, sigma, q;
+    ui64 nSim;
+};
+
+/*******************************************
+ * @brief Request queue between the readers and the batcher.
+ *******************************************/
+struct request_queue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<pricing_request> q;
+    bool closed = false;
+};
+
+static std::atomic<bool> g_stop(false);
+
+static void on_signal(int) { g_stop = true; }
+
+/*******************************************
+ * @brief Parses one request line; returns false on malformed input.
+ *******************************************/
+static bool parse_request(const std::string &line, pricing_request &req) {
+    char id[64], type[4];
+    unsigned long long n;
+    int got = std::sscanf(line.c_str(), "%63s %3s %lf %lf %lf %lf %lf %lf %llu",
+                          id, type, &req.S0, &req.K, &req.T, &req.r,
+                          &req.sigma, &req.q, &n);
+    if (got != 9 || n == 0 || n > MAX_SIMS || type[1] != '\0') return false;
+    if (type[0] == 'C' || type[0] == 'c') req.isCall = 1;
+    else if (type[0] == 'P' || type[0] == 'p') req.isCall = 0;
+    else return false;
+    // Written so NaN fails every test.
+    if (!(req.S0 > 0.0) || !(req.K > 0.0) || !(req.T > 0.0) || !(req.sigma > 0.0)
+        || !std::isfinite(req.S0) || !std::isfinite(req.K) || !std::isfinite(req.T)
+        || !std::isfinite(req.sigma) || !std::isfinite(req.r) || !std::isfinite(req.q))
+        return false;
+    req.id = id;
+    req.nSim = n;
+    return true;
+}
+
+/*******************************************
+ * @brief Splits buffered input into lines and queues the requests.
+ *******************************************/
+static void consume_lines(const std::shared_ptr<connection> &c, request_queue &Q) {
+    size_t pos;
+    while ((pos = c->inbuf.find('\n')) != std::string::npos) {
+        std::string line = c->inbuf.substr(0, pos);
+        c->inbuf.erase(0, pos + 1);
+        pricing_request req;
+        if (!parse_request(line, req)) {
+            req = pricing_request();
+            req.malformed = true;
+        }
+        req.conn = c;
+        std::lock_guard<std::mutex> lk(Q.m);
+        Q.q.push_back(std::move(req));
+        Q.cv.notify_one();
+    }
+}
+
+/*******************************************
+ * @brief Reads requests from stdin until EOF.
+ *******************************************/
+static void stdin_reader(request_queue &Q) {
+    auto c = std::make_shared<connection>(STDOUT_FILENO, false);
+    char buf[4096];
+    ssize_t n;
+    while (!g_stop && (n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        c->inbuf.append(buf, size_t(n));
+        consume_lines(c, Q);
+    }
+    std::lock_guard<std::mutex> lk(Q.m);
+    Q.closed = true;
+    Q.cv.notify_one();
+}
+
+/*******************************************
+ * @brief Sends as much queued output as the socket takes without blocking.
+ *
+ * @return false if the client is gone or was dropped.
+ *******************************************/
+static bool flush_output(connection &c) {
+    std::lock_guard<std::mutex> lk(c.outMutex);
+    if (c.dropped) return false;
+    size_t off = 0;
+    while (off < c.outbuf.size()) {
+        ssize_t n = write(c.fd, c.outbuf.data() + off, c.outbuf.size() - off);
+        if (n > 0) { off += size_t(n); continue; }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+        return false;
+    }
+    c.outbuf.erase(0, off);
+    return true;
+}
+
+/*******************************************
+ * @brief Accepts clients on a Unix socket, reads their requests and
+ *        sends the queued replies.
+ *
+ * A client that hung up stays in the table until its pending requests
+ * are answered and flushed.
+ *******************************************/
+static void socket_reader(int lfd, request_queue &Q) {
+    std::map<int, std::shared_ptr<connection>> conns;
+    std::vector<pollfd> fds;
+    char buf[4096];
+
+    while (!g_stop) {
+        fds.clear();
+        fds.push_back({lfd, POLLIN, 0});
+        fds.push_back({g_wake[0], POLLIN, 0});
+        for (auto it = conns.begin(); it != conns.end();) {
+            connection &c = *it->second;
+            // Read before the buffer: the batcher queues replies before
+            // it releases the requests.
+            bool idle = it->second.use_count() == 1;
+            bool pending;
+            {
+                std::lock_guard<std::mutex> lk(c.outMutex);
+                pending = !c.outbuf.empty() && !c.dropped;
+                if (c.dropped) shutdown(c.fd, SHUT_RDWR);
+            }
+            if (c.dropped || (c.readClosed && !pending && idle)) {
+                it = conns.erase(it);
+                continue;
+            }
+            short ev = short((c.readClosed ? 0 : POLLIN) | (pending ? POLLOUT : 0));
+            fds.push_back({it->first, ev, 0});
+            ++it;
+        }
+        if (poll(fds.data(), fds.size(), 100) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            int cfd = accept(lfd, nullptr, nullptr);
+            if (cfd >= 0) {
+                fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+                conns[cfd] = std::make_shared<connection>(cfd, true);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            while (read(g_wake[0], buf, sizeof(buf)) > 0) {}
+        }
+        for (size_t i = 2; i < fds.size(); i++) {
+            auto it = conns.find(fds[i].fd);
+            connection &c = *it->second;
+            if (fds[i].revents & POLLOUT) {
+                if (!flush_output(c)) {
+                    std::lock_guard<std::mutex> lk(c.outMutex);
+                    c.dropped = true;
+                    continue;
+                }
+            }
+            if (c.readClosed || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+            if (n <= 0) {
+                shutdown(fds[i].fd, SHUT_RD);
+                c.readClosed = true;
+                continue;
+            }
+            c.inbuf.append(buf, size_t(n));
+            consume_lines(it->second, Q);
+        }
+    }
+    std::lock_guard<std::mutex> lk(Q.m);
+    Q.closed = true;
+    Q.cv.notify_one();
+}
+
+/*******************************************
+ * @brief Per-thread accumulators, padded so threads never share a line.
+ *******************************************/
+struct alignas(64) batch_accumulator {
+    double sum;
+    double sumSq;
+    double pad[6];
+};
+
+/*******************************************
+ * @brief Buffers allocated once at startup and reused by every batch.
+ *******************************************/
+struct server_buffers {
+    int nThreads;
+    int maxBatch;
+    std::vector<double*> normals;            // CHUNK normals per thread
+    std::vector<batch_accumulator> acc;       // [thread][request]
+    std::vector<double> drift, vol, S0, K, sign;
+
+    server_buffers(int threads, int batch) : nThreads(threads), maxBatch(batch),
+        normals(threads), acc(size_t(threads) * batch), drift(batch), vol(batch),
+        S0(batch), K(batch), sign(batch) {
+        #pragma omp parallel num_threads(nThreads)
+        {
+            // First touch by the owning thread.
+            int t = omp_get_thread_num();
+            normals[t] = static_cast<double*>(aligned_alloc(64, CHUNK * sizeof(double)));
+            std::memset(normals[t], 0, CHUNK * sizeof(double));
+        }
+    }
+
+    ~server_buffers() {
+        for (double *p : normals) free(p);
+    }
+};
+
+/*******************************************
+ * @brief Prices a batch, sharing every block of normals between requests.
+ *
+ * Block b of the batch is seeded from (batchIndex, b) so results do not
+ * depend on the thread count.
+ *
+ * @param reqs Requests of the batch.
+ * @param B Preallocated buffers.
+ * @param batchIndex Running batch counter.
+ * @param price Output prices.
+ * @param stderrOut Output standard errors.
+ *******************************************/
+static void price_batch(const std::vector<pricing_request> &reqs, server_buffers &B,
+                        ui64 batchIndex, double *price, double *stderrOut) {
+    const int n = int(reqs.size());
+    ui64 nMax = 0;
+    for (int j = 0; j < n; j++) {
+        const pricing_request &rq = reqs[j];
+        B.drift[j] = (rq.r - rq.q - 0.5 * rq.sigma * rq.sigma) * rq.T;
+        B.vol[j] = rq.sigma * std::sqrt(rq.T);
+        B.S0[j] = rq.S0;
+        B.K[j] = rq.K;
+        B.sign[j] = rq.isCall ? 1.0 : -1.0;
+        nMax = std::max(nMax, rq.nSim);
+    }
+    for (auto &a : B.acc) { a.sum = 0.0; a.sumSq = 0.0; }
+
+    ui64 nBlocks = (nMax + CHUNK - 1) / CHUNK;
+
+    #pragma omp parallel num_threads(B.nThreads)
+    {
+        int t = omp_get_thread_num();
+        double *g = B.normals[t];
+        batch_accumulator *acc = &B.acc[size_t(t) * B.maxBatch];
+
+        #pragma omp for schedule(static)
+        for (ui64 b = 0; b < nBlocks; b++) {
+            xorshift128plus_state rng;
+            xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0xA5ULL * (batchIndex + 1)) ^ (0x9E37ULL * (b + 1))));
+            normal_block(rng, g, CHUNK);
+
+            for (int j = 0; j < n; j++) {
+                ui64 first = b * CHUNK;
+                if (first >= reqs[j].nSim) continue;
+                int cnt = int(std::min<ui64>(CHUNK, reqs[j].nSim - first));
+                const double d = B.drift[j], v = B.vol[j], s0 = B.S0[j];
+                const double k = B.K[j], w = B.sign[j];
+                double sum = 0.0, sumSq = 0.0;
+                #pragma omp simd reduction(+:sum, sumSq)
+                for (int i = 0; i < cnt; i++) {
+                    double ST = s0 * std::exp(d + v * g[i]);
+                    double pay = std::max(w * (ST - k), 0.0);
+                    sum += pay;
+                    sumSq += pay * pay;
+                }
+                acc[j].sum += sum;
+                acc[j].sumSq += sumSq;
+            }
+        }
+    }
+
+    for (int j = 0; j < n; j++) {
+        double sum = 0.0, sumSq = 0.0;
+        for (int t = 0; t < B.nThreads; t++) {
+            sum += B.acc[size_t(t) * B.maxBatch + j].sum;
+            sumSq += B.acc[size_t(t) * B.maxBatch + j].sumSq;
+        }
+        double N = double(reqs[j].nSim);
+        double mean = sum / N;
+        double var = std::max(sumSq / N - mean * mean, 0.0);
+        double disc = std::exp(-reqs[j].r * reqs[j].T);
+        price[j] = disc * mean;
+        stderrOut[j] = disc * std::sqrt(var / N);
+    }
+}
+
+/*******************************************
+ * @brief Writes a whole buffer, ignoring clients that went away.
+ *******************************************/
+static void write_all(int fd, const std::string &s) {
+    size_t off = 0;
+    while (off < s.size()) {
+        ssize_t n = write(fd, s.data() + off, s.size() - off);
+        if (n <= 0) return;
+        off += size_t(n);
+    }
+}
+
+/*******************************************
+ * @brief Hands replies to a client.
+ *
+ * stdout (the only client in "-" mode) is written directly. Socket
+ * clients get the text appended to their output buffer for the poll
+ * loop to send; past MAX_BACKLOG unsent bytes the client is dropped.
+ *******************************************/
+static void deliver(connection &c, const std::string &text) {
+    if (!c.owned) {
+        write_all(c.fd, text);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lk(c.outMutex);
+        if (c.dropped) return;
+        if (c.outbuf.size() + text.size() > MAX_BACKLOG) {
+            c.dropped = true;
+            c.outbuf.clear();
+        } else {
+            c.outbuf += text;
+        }
+    }
+    char one = 1;
+    (void)!write(g_wake[1], &one, 1);
+}
+
+/*******************************************
+ * @brief Main function: starts the readers and runs the batching loop.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values (socket path or "-", max batch, window).
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket_path | -> [max_batch] [window_us]\n";
+        return 1;
+    }
+    std::string path = argv[1];
+    int maxBatch = (argc > 2) ? std::atoi(argv[2]) : 64;
+    double windowUs = (argc > 3) ? std::atof(argv[3]) : 200.0;
+    if (maxBatch < 1) maxBatch = 1;
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    int nThreads = omp_get_max_threads();
+    server_buffers B(nThreads, maxBatch);
+    request_queue Q;
+    std::thread reader;
+    int lfd = -1;
+
+    if (path == "-") {
+        reader = std::thread(stdin_reader, std::ref(Q));
+    } else {
+        if (pipe(g_wake) != 0) {
+            std::perror("BSM_server");
+            return 1;
+        }
+        for (int e = 0; e < 2; e++) fcntl(g_wake[e], F_SETFL, fcntl(g_wake[e], F_GETFL) | O_NONBLOCK);
+        lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (lfd < 0 || bind(lfd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 128) != 0) {
+            std::perror("BSM_server");
+            return 1;
+        }
+        reader = std::thread(socket_reader, lfd, std::ref(Q));
+    }
+
+    std::cerr << "BSM_server ready on " << path << "   threads= " << nThreads
+              << "   max_batch= " << maxBatch << "   window_us= " << windowUs << std::endl;
+
+    std::vector<pricing_request> batch, valid;
+    std::vector<double> price(maxBatch), se(maxBatch);
+    batch.reserve(maxBatch);
+    valid.reserve(maxBatch);
+    ui64 batchIndex = 0, served = 0;
+    double busyUs = 0.0;
+
+    for (;;) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lk(Q.m);
+            Q.cv.wait(lk, [&] { return !Q.q.empty() || Q.closed; });
+            if (Q.q.empty()) break;
+
+            // Coalesce whatever arrives within the window.
+            double deadline = dml_micros() + windowUs;
+            for (;;) {
+                while (!Q.q.empty() && int(batch.size()) < maxBatch) {
+                    batch.push_back(std::move(Q.q.front()));
+                    Q.q.pop_front();
+                }
+                double now = dml_micros();
+                if (int(batch.size()) >= maxBatch || now >= deadline || Q.closed) break;
+                Q.cv.wait_for(lk, std::chrono::microseconds(ui64(deadline - now)));
+            }
+        }
+
+        // Malformed lines are rare: only then price a copy without them.
+        size_t nBad = 0;
+        for (const pricing_request &req : batch) nBad += req.malformed;
+        const std::vector<pricing_request> *priced = &batch;
+        if (nBad > 0) {
+            valid.clear();
+            for (const pricing_request &req : batch)
+                if (!req.malformed) valid.push_back(req);
+            priced = &valid;
+        }
+
+        double t1 = dml_micros();
+        if (!priced->empty()) price_batch(*priced, B, batchIndex++, price.data(), se.data());
+        busyUs += dml_micros() - t1;
+
+        // Group the answers per connection so each client gets one write.
+        std::map<connection*, std::string> out;
+        char line[128];
+        for (size_t j = 0, k = 0; j < batch.size(); j++) {
+            if (batch[j].malformed) {
+                out[batch[j].conn.get()] += "error malformed request\n";
+                continue;
+            }
+            std::snprintf(line, sizeof(line), " %.6f %.6f\n", price[k], se[k]);
+            out[batch[j].conn.get()] += batch[j].id + line;
+            k++;
+        }
+        for (auto &kv : out) deliver(*kv.first, kv.second);
+        served += batch.size() - nBad;
+        // Release the connections now, not when the next batch arrives.
+        batch.clear();
+        valid.clear();
+    }
+
+    g_stop = true;
+    reader.join();
+    if (lfd >= 0) {
+        close(lfd);
+        unlink(path.c_str());
+    }
+    std::cerr << std::fixed << "BSM_server served " << served << " requests in "
+              << batchIndex << " batches, busy " << busyUs * 1e-6 << " s\n";
+    return 0;
+}
@@ -0,0 +1,670 @@
+#include <iostream>
+#include <amath.h>
+#include <armpl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+#include <omp.h>
+#include "BSM_kernels.h"
+
+/*
+    Payoff distribution sketches.
+
+    Usage: [mpirun -n <ranks>] ./BSM_sketch <num_sims> [k] [--mean-only]
+
+    Prices the call (S0=100, K=110, T=1, r=0.06, sigma=0.2) and, next to
+    the mean, streams every discounted payoff and terminal spot into two
+    fixed-size summaries per thread:
+        - a log-binned histogram (32 linear sub-bins per power of two,
+          2^-20 .. 2^24) holding counts and value sums per bin;
+        - a KLL quantile sketch with parameter k (default 256).
+    Thread summaries are merged in thread order, then across MPI ranks on
+    rank 0. Their size depends on k and on the bin layout, not on the
+    number of paths (the KLL sketch grows by one short level each time
+    the path count doubles).
+
+    Reported: mean, standard deviation, skewness, excess kurtosis,
+    quantiles (KLL, histogram and closed form), tail means and the VaR /
+    expected shortfall of a short call sold at the Monte Carlo price.
+    --mean-only skips the sketches, to measure their cost.
+*/
+
+#define CHUNK 256
+
+/*******************************************
+ * @brief Inverse standard normal CDF (Acklam), for the exact quantiles.
+ *******************************************/
+static double norm_inv(double p) {
+    const double a1 = -3.969683028665376e+01, a2 = 2.209460984245205e+02;
+    const double a3 = -2.759285104469687e+02, a4 = 1.383577518672690e+02;
+    const double a5 = -3.066479806614716e+01, a6 = 2.506628277459239e+00;
+    const double b1 = -5.447609879822406e+01, b2 = 1.615858368580409e+02;
+    const double b3 = -1.556989798598866e+02, b4 = 6.680131188771972e+01;
+    const double b5 = -1.328068155288572e+01;
+    const double c1 = -7.784894002430293e-03, c2 = -3.223964580411365e-01;
+    const double c3 = -2.400758277161838e+00, c4 = -2.549732539343734e+00;
+    const double c5 = 4.374664141464968e+00, c6 = 2.938163982698783e+00;
+    const double d1 = 7.784695709041462e-03, d2 = 3.224671290700398e-01;
+    const double d3 = 2.445134137142996e+00, d4 = 3.754408661907416e+00;
+    const double pLow = 0.02425;
+
+    if (p < pLow || p > 1.0 - pLow) {
+        double t = std::sqrt(-2.0 * std::log(std::min(p, 1.0 - p)));
+        double z = (((((c1 * t + c2) * t + c3) * t + c4) * t + c5) * t + c6)
+                 / ((((d1 * t + d2) * t + d3) * t + d4) * t + 1.0);
+        return (p < 0.5) ? z : -z;
+    }
+    double q = p - 0.5, u = q * q;
+    return (((((a1 * u + a2) * u + a3) * u + a4) * u + a5) * u + a6) * q
+         / (((((b1 * u + b2) * u + b3) * u + b4) * u + b5) * u + 1.0);
+}
+
+/*******************************************
+ * @brief Log-binned histogram of non-negative values.
+ *
+ * Bin 0 takes everything below 2^MIN_EXP (zeros included), the last bin
+ * everything from 2^MAX_EXP. In between, each power of two is split in
+ * SUB linear sub-bins read straight from the exponent and the top
+ * mantissa bits, so the relative width of a bin is at most 1/SUB.
+ * Each bin keeps the sum of its values, which makes tail means exact
+ * up to the one partially used bin.
+ *******************************************/
+struct log_histogram {
+    static const int SUB_BITS = 5;
+    static const int SUB = 1 << SUB_BITS;
+    static const int MIN_EXP = -20;
+    static const int MAX_EXP = 24;
+    static const int NBINS = (MAX_EXP - MIN_EXP) * SUB + 2;
+
+    std::vector<double> count;   // exact up to 2^53 per bin
+    std::vector<double> sum;
+
+    void init() {
+        count.assign(NBINS, 0.0);
+        sum.assign(NBINS, 0.0);
+    }
+
+    static inline int bin_of(double x) {
+        ui64 bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        int e = int(bits >> 52) - 1023;
+        int m = int((bits >> (52 - SUB_BITS)) & (SUB - 1));
+        int idx = (e - MIN_EXP) * SUB + m + 1;
+        return std::min(std::max(idx, 0), NBINS - 1);
+    }
+
+    static double lower_edge(int idx) {
+        if (idx <= 0) return 0.0;
+        int j = idx - 1;
+        return std::ldexp(1.0 + double(j % SUB) / SUB, MIN_EXP + j / SUB);
+    }
+
+    static double upper_edge(int idx) {
+        if (idx <= 0) return std::ldexp(1.0, MIN_EXP);
+        int j = idx - 1;
+        return std::ldexp(1.0 + double(j % SUB + 1) / SUB, MIN_EXP + j / SUB);
+    }
+
+    void add_block(const double *x, int n) {
+        alignas(64) int idx[CHUNK];
+        #pragma omp simd
+        for (int i = 0; i < n; i++) idx[i] = bin_of(x[i]);
+        for (int i = 0; i < n; i++) {
+            count[idx[i]] += 1.0;
+            sum[idx[i]] += x[i];
+        }
+    }
+
+    void merge(const log_histogram &o) {
+        for (int b = 0; b < NBINS; b++) {
+            count[b] += o.count[b];
+            sum[b] += o.sum[b];
+        }
+    }
+
+    /*******************************************
+     * @brief Quantile, interpolated linearly inside its bin.
+     *
+     * Values below 2^MIN_EXP are reported as 0, values in the overflow
+     * bin as the observed maximum.
+     *******************************************/
+    double quantile(double q, double n, double maxValue) const {
+        double target = q * n, cum = 0.0;
+        for (int b = 0; b < NBINS; b++) {
+            if (count[b] == 0.0 || cum + count[b] < target) {
+                cum += count[b];
+                continue;
+            }
+            if (b == 0) return 0.0;
+            if (b == NBINS - 1) return maxValue;
+            double frac = (target - cum) / count[b];
+            return lower_edge(b) + frac * (upper_edge(b) - lower_edge(b));
+        }
+        return maxValue;
+    }
+
+    /*******************************************
+     * @brief Mean of the values in the upper (or lower) fraction of mass.
+     *
+     * The bin straddling the cut contributes its mean times the part of
+     * its count that is needed.
+     *******************************************/
+    double tail_mean(double frac, double n, bool upper) const {
+        double need = frac * n, got = 0.0, acc = 0.0;
+        for (int k = 0; k < NBINS && got < need; k++) {
+            int b = upper ? NBINS - 1 - k : k;
+            if (count[b] == 0.0) continue;
+            double take = std::min(count[b], need - got);
+            acc += take * (sum[b] / count[b]);
+            got += take;
+        }
+        return got > 0.0 ? acc / got : 0.0;
+    }
+};
+
+/*******************************************
+ * @brief KLL quantile sketch (Karnin, Lang, Liberty).
+ *
+ * Level h holds items of weight 2^h. When a level reaches its capacity
+ * (k at the top, shrinking by 2/3 per level below, at least 2) it is
+ * sorted and every other item, starting at a random offset, moves up
+ * one level. As in the paper, the bottom levels that would sit at the
+ * minimum capacity are replaced by a sampler: new items enter at level
+ * s as one uniformly picked item per group of 2^s inputs, so most
+ * inputs are never sorted. Rank error is about 1.7/k of the count with
+ * high probability; for the far tails the histogram is the better
+ * source.
+ *******************************************/
+struct kll_sketch {
+    int k = 256;
+    double n = 0.0;
+    std::vector<std::vector<double>> levels;
+    std::vector<int> caps;
+    xorshift128plus_state coin;
+    int s = 0;                  // level fed by the sampler
+    ui64 groupPos = 0;          // inputs seen in the current group
+    ui64 pick = 0;              // position kept in the current group
+    double candidate = 0.0;
+
+    void init(int k_, ui64 seed) {
+        k = k_;
+        n = 0.0;
+        s = 0;
+        groupPos = 0;
+        levels.assign(1, std::vector<double>());
+        levels[0].reserve(k + CHUNK);
+        xorshift128plus_init(coin, seed_mix(seed));
+        update_caps();
+    }
+
+    void update_caps() {
+        int H = int(levels.size());
+        caps.resize(H);
+        for (int h = 0; h < H; h++) {
+            int c = int(std::ceil(k * std::pow(2.0 / 3.0, H - 1 - h)));
+            caps[h] = std::max(c, 2);
+        }
+    }
+
+    void compress() {
+        for (;;) {
+            int H = int(levels.size()), h = 0;
+            while (h < H && int(levels[h].size()) < caps[h]) h++;
+            if (h == H) return;
+            if (h + 1 == H) {
+                levels.emplace_back();
+                levels.back().reserve(k + 1);
+                update_caps();
+            }
+            std::vector<double> &src = levels[h];
+            std::vector<double> &dst = levels[h + 1];
+            std::sort(src.begin(), src.end());
+            // With an odd count the smallest item stays, so weight is kept.
+            size_t keep = src.size() & 1;
+            size_t off = xorshift128plus(coin) >> 63;
+            for (size_t i = keep + off; i < src.size(); i += 2) dst.push_back(src[i]);
+            src.resize(keep);
+        }
+    }
+
+    /*******************************************
+     * @brief Starts a sampler group: raises s past the minimum-capacity
+     *        levels and draws the position to keep.
+     *******************************************/
+    void start_group() {
+        int H = int(levels.size());
+        while (s + 1 < H && caps[s] <= 2) s++;
+        if (s > 0) pick = xorshift128plus(coin) & ((1ULL << s) - 1);
+    }
+
+    void add_block(const double *x, int cnt) {
+        n += cnt;
+        int i = 0;
+        while (i < cnt) {
+            if (groupPos == 0) start_group();
+            if (s == 0) {
+                levels[0].insert(levels[0].end(), x + i, x + cnt);
+                i = cnt;
+                if (int(levels[0].size()) >= caps[0]) compress();
+                continue;
+            }
+            ui64 G = 1ULL << s;
+            ui64 take = std::min<ui64>(cnt - i, G - groupPos);
+            if (pick >= groupPos && pick < groupPos + take) candidate = x[i + (pick - groupPos)];
+            groupPos += take;
+            i += int(take);
+            if (groupPos < G) break;
+            groupPos = 0;
+            levels[s].push_back(candidate);
+            if (int(levels[s].size()) >= caps[s]) compress();
+        }
+    }
+
+    /*******************************************
+     * @brief Merges another sketch; both unfinished sampler groups are
+     *        dropped (at most 2^s inputs each).
+     *******************************************/
+    void merge(const kll_sketch &o) {
+        if (o.levels.size() > levels.size()) {
+            levels.resize(o.levels.size());
+            update_caps();
+        }
+        for (size_t h = 0; h < o.levels.size(); h++)
+            levels[h].insert(levels[h].end(), o.levels[h].begin(), o.levels[h].end());
+        n += o.n;
+        s = std::max(s, o.s);
+        groupPos = 0;
+        compress();
+    }
+
+    size_t items() const {
+        size_t c = 0;
+        for (const auto &l : levels) c += l.size();
+        return c;
+    }
+
+    /*******************************************
+     * @brief Quantiles for several ranks from one sorted weighted view.
+     *
+     * Ranks are taken against the retained weight, which differs from n
+     * only by the dropped sampler groups.
+     *******************************************/
+    std::vector<double> quantiles(const std::vector<double> &qs) const {
+        std::vector<std::pair<double, double>> view;
+        double W = 0.0;
+        for (size_t h = 0; h < levels.size(); h++) {
+            for (double v : levels[h]) {
+                view.push_back({v, std::ldexp(1.0, int(h))});
+                W += std::ldexp(1.0, int(h));
+            }
+        }
+        std::sort(view.begin(), view.end());
+        std::vector<double> out;
+        for (double q : qs) {
+            double target = q * W, cum = 0.0;
+            double v = view.empty() ? 0.0 : view.back().first;
+            for (const auto &it : view) {
+                cum += it.second;
+                if (cum >= target) { v = it.first; break; }
+            }
+            out.push_back(v);
+        }
+        return out;
+    }
+};
+
+/*******************************************
+ * @brief Shifted power sums, min and max of a stream.
+ *
+ * The shift (a rough guess of the mean) keeps the higher moments from
+ * cancelling when they are turned into central moments.
+ *******************************************/
+struct stream_moments {
+    double shift = 0.0;
+    double n = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0;
+    double lo = 1e300, hi = -1e300;
+
+    void add_block(const double *x, int cnt) {
+        double a1 = 0.0, a2 = 0.0, a3 = 0.0, a4 = 0.0, mn = lo, mx = hi;
+        #pragma omp simd reduction(+:a1,a2,a3,a4) reduction(min:mn) reduction(max:mx)
+        for (int i = 0; i < cnt; i++) {
+            double d = x[i] - shift, d2 = d * d;
+            a1 += d;
+            a2 += d2;
+            a3 += d2 * d;
+            a4 += d2 * d2;
+            mn = std::min(mn, x[i]);
+            mx = std::max(mx, x[i]);
+        }
+        n += cnt;
+        s1 += a1; s2 += a2; s3 += a3; s4 += a4;
+        lo = mn; hi = mx;
+    }
+
+    void merge(const stream_moments &o) {
+        n += o.n;
+        s1 += o.s1; s2 += o.s2; s3 += o.s3; s4 += o.s4;
+        lo = std::min(lo, o.lo);
+        hi = std::max(hi, o.hi);
+    }
+
+    double mean() const { return shift + s1 / n; }
+
+    /*******************************************
+     * @brief Central moments m2, m3, m4 from the shifted sums.
+     *******************************************/
+    void central(double &m2, double &m3, double &m4) const {
+        double d = s1 / n, e2 = s2 / n, e3 = s3 / n, e4 = s4 / n;
+        m2 = e2 - d * d;
+        m3 = e3 - 3.0 * d * e2 + 2.0 * d * d * d;
+        m4 = e4 - 4.0 * d * e3 + 6.0 * d * d * e2 - 3.0 * d * d * d * d;
+    }
+};
+
+/*******************************************
+ * @brief All summaries of one stream (payoff or terminal spot).
+ *******************************************/
+struct stream_sketch {
+    stream_moments mom;
+    log_histogram hist;
+    kll_sketch kll;
+
+    void init(double shift, int k, ui64 seed) {
+        mom = stream_moments();
+        mom.shift = shift;
+        hist.init();
+        kll.init(k, seed);
+    }
+
+    void add_block(const double *x, int n) {
+        mom.add_block(x, n);
+        hist.add_block(x, n);
+        kll.add_block(x, n);
+    }
+
+    void merge(const stream_sketch &o) {
+        mom.merge(o.mom);
+        hist.merge(o.hist);
+        kll.merge(o.kll);
+    }
+
+    size_t bytes() const {
+        size_t b = sizeof(*this) + 2 * log_histogram::NBINS * sizeof(double);
+        for (const auto &l : kll.levels) b += l.capacity() * sizeof(double);
+        return b;
+    }
+
+    /*******************************************
+     * @brief Appends the sketch to a flat buffer of doubles (for MPI).
+     *******************************************/
+    void pack(std::vector<double> &buf) const {
+        buf.insert(buf.end(), {mom.n, mom.s1, mom.s2, mom.s3, mom.s4, mom.lo, mom.hi});
+        buf.insert(buf.end(), hist.count.begin(), hist.count.end());
+        buf.insert(buf.end(), hist.sum.begin(), hist.sum.end());
+        buf.push_back(kll.n);
+        buf.push_back(double(kll.s));
+        buf.push_back(double(kll.levels.size()));
+        for (const auto &l : kll.levels) buf.push_back(double(l.size()));
+        for (const auto &l : kll.levels) buf.insert(buf.end(), l.begin(), l.end());
+    }
+
+    /*******************************************
+     * @brief Reads a packed sketch into an initialised one.
+     *
+     * @return Pointer past the consumed values.
+     *******************************************/
+    const double* unpack(const double *p) {
+        mom.n = p[0]; mom.s1 = p[1]; mom.s2 = p[2]; mom.s3 = p[3]; mom.s4 = p[4];
+        mom.lo = p[5]; mom.hi = p[6];
+        p += 7;
+        hist.count.assign(p, p + log_histogram::NBINS);
+        p += log_histogram::NBINS;
+        hist.sum.assign(p, p + log_histogram::NBINS);
+        p += log_histogram::NBINS;
+        kll.n = p[0];
+        kll.s = int(p[1]);
+        kll.groupPos = 0;
+        int H = int(p[2]);
+        p += 3;
+        std::vector<size_t> sizes(H);
+        for (int h = 0; h < H; h++) sizes[h] = size_t(p[h]);
+        p += H;
+        kll.levels.assign(H, std::vector<double>());
+        for (int h = 0; h < H; h++) {
+            kll.levels[h].assign(p, p + sizes[h]);
+            p += sizes[h];
+        }
+        kll.update_caps();
+        return p;
+    }
+};
+
+/*******************************************
+ * @brief Contract parameters.
+ *******************************************/
+struct contract {
+    double S0, K, T, r, sigma;
+};
+
+/*******************************************
+ * @brief Simulates this rank's share of blocks.
+ *
+ * Blocks are numbered globally and seeded from their number, so the
+ * paths do not depend on the rank or thread count.
+ *
+ * @param c Contract.
+ * @param firstBlock First global block of this rank.
+ * @param nBlocks Number of blocks of this rank.
+ * @param k KLL parameter.
+ * @param sketch Whether to feed the sketches.
+ * @param payOut Merged payoff sketch of this rank.
+ * @param spotOut Merged terminal spot sketch of this rank.
+ * @param rank MPI rank, to seed the KLL coins.
+ * @return Sum of discounted payoffs.
+ *******************************************/
+static double simulate(const contract &c, ui64 firstBlock, ui64 nBlocks, int k,
+                       bool sketch, stream_sketch &payOut, stream_sketch &spotOut, int rank) {
+    const double drift = (c.r - 0.5 * c.sigma * c.sigma) * c.T;
+    const double vol = c.sigma * std::sqrt(c.T);
+    const double disc = std::exp(-c.r * c.T);
+    const double fwd = c.S0 * std::exp(c.r * c.T);
+    const int nThreads = omp_get_max_threads();
+    std::vector<stream_sketch> pay(nThreads), spot(nThreads);
+    double total = 0.0;
+
+    #pragma omp parallel num_threads(nThreads) reduction(+:total)
+    {
+        int t = omp_get_thread_num();
+        ui64 seed = (ui64(rank) << 20) + ui64(t);
+        if (sketch) {
+            pay[t].init(0.0, k, 2 * seed);
+            spot[t].init(fwd, k, 2 * seed + 1);
+        }
+        alignas(64) double g[CHUNK];
+        alignas(64) double ST[CHUNK];
+        alignas(64) double P[CHUNK];
+
+        #pragma omp for schedule(static)
+        for (ui64 b = 0; b < nBlocks; b++) {
+            xorshift128plus_state rng;
+            xorshift128plus_init(rng, seed_mix(0xDEADBEEF ^ (0x9E37ULL * (firstBlock + b + 1))));
+            normal_block(rng, g, CHUNK);
+
+            double local = 0.0;
+            #pragma omp simd reduction(+:local)
+            for (int i = 0; i < CHUNK; i++) {
+                ST[i] = c.S0 * std::exp(drift + vol * g[i]);
+                P[i] = disc * std::max(ST[i] - c.K, 0.0);
+                local += P[i];
+            }
+            total += local;
+
+            if (sketch) {
+                pay[t].add_block(P, CHUNK);
+                spot[t].add_block(ST, CHUNK);
+            }
+        }
+    }
+
+    if (sketch) {
+        payOut = std::move(pay[0]);
+        spotOut = std::move(spot[0]);
+        for (int t = 1; t < nThreads; t++) {
+            payOut.merge(pay[t]);
+            spotOut.merge(spot[t]);
+        }
+    }
+    return total;
+}
+
+/*******************************************
+ * @brief Merges the sketches of all ranks on rank 0, in rank order.
+ *******************************************/
+static void merge_ranks(stream_sketch &pay, stream_sketch &spot, int k, int rank, int size) {
+    if (size == 1) return;
+    std::vector<double> buf;
+    pay.pack(buf);
+    spot.pack(buf);
+    int len = int(buf.size());
+    std::vector<int> lens(size), displs(size);
+    MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<double> all;
+    if (rank == 0) {
+        int off = 0;
+        for (int i = 0; i < size; i++) { displs[i] = off; off += lens[i]; }
+        all.resize(off);
+    }
+    MPI_Gatherv(buf.data(), len, MPI_DOUBLE, all.data(), lens.data(), displs.data(),
+                MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (rank != 0) return;
+    for (int i = 1; i < size; i++) {
+        const double *p = all.data() + displs[i];
+        stream_sketch a, b;
+        a.init(pay.mom.shift, k, 0);
+        b.init(spot.mom.shift, k, 0);
+        p = a.unpack(p);
+        b.unpack(p);
+        pay.merge(a);
+        spot.merge(b);
+    }
+}
+
+/*******************************************
+ * @brief Prints moments of one stream.
+ *******************************************/
+static void print_moments(const char *name, const stream_sketch &s) {
+    double m2, m3, m4;
+    s.mom.central(m2, m3, m4);
+    std::cout << std::fixed << std::setprecision(6)
+              << std::left << std::setw(8) << name << std::right
+              << "  mean= " << s.mom.mean() << "  stdev= " << std::sqrt(m2)
+              << "  skew= " << m3 / std::pow(m2, 1.5) << "  exkurt= " << m4 / (m2 * m2) - 3.0
+              << "  min= " << s.mom.lo << "  max= " << s.mom.hi << "\n";
+}
+
+/*******************************************
+ * @brief Main function: simulation, merge and report on rank 0.
+ *
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return Execution status.
+ *******************************************/
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (argc < 2) {
+        if (rank == 0)
+            std::cerr << "Usage: [mpirun -n <procs>] " << argv[0]
+                      << " <num_sims> [k] [--mean-only]\n";
+        MPI_Finalize();
+        return 1;
+    }
+    ui64 nSim = std::stoull(argv[1]);
+    int k = 256;
+    bool sketch = true;
+    for (int a = 2; a < argc; a++) {
+        std::string opt = argv[a];
+        if (opt == "--mean-only") sketch = false;
+        else k = std::max(8, std::atoi(argv[a]));
+    }
+
+    const contract c = {100.0, 110.0, 1.0, 0.06, 0.2};
+    ui64 totalBlocks = (nSim + CHUNK - 1) / CHUNK;
+    ui64 per = totalBlocks / size, extra = totalBlocks % size;
+    ui64 firstBlock = rank * per + std::min<ui64>(rank, extra);
+    ui64 nBlocks = per + (ui64(rank) < extra ? 1 : 0);
+
+    if (rank == 0) {
+        std::cout << "paths= " << totalBlocks * CHUNK << "   ranks= " << size
+                  << "   threads= " << omp_get_max_threads()
+                  << "   k= " << (sketch ? k : 0) << std::endl;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double t1 = dml_micros();
+    stream_sketch pay, spot;
+    double local = simulate(c, firstBlock, nBlocks, k, sketch, pay, spot, rank);
+    double total = 0.0;
+    MPI_Reduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (sketch) merge_ranks(pay, spot, k, rank, size);
+    double t2 = dml_micros();
+
+    if (rank == 0) {
+        double N = double(totalBlocks * CHUNK);
+        double price = total / N;
+        double elapsed = (t2 - t1) * 1e-6;
+
+        if (sketch) {
+            print_moments("payoff", pay);
+            print_moments("spot", spot);
+
+            const std::vector<double> qs = {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999};
+            std::vector<double> kPay = pay.kll.quantiles(qs), kSpot = spot.kll.quantiles(qs);
+            const double drift = (c.r - 0.5 * c.sigma * c.sigma) * c.T;
+            const double vol = c.sigma * std::sqrt(c.T);
+            const double disc = std::exp(-c.r * c.T);
+            std::cout << "quantile    spot: kll        hist       exact   payoff: kll        hist       exact\n";
+            for (size_t i = 0; i < qs.size(); i++) {
+                double sExact = c.S0 * std::exp(drift + vol * norm_inv(qs[i]));
+                std::cout << std::fixed << std::setprecision(3) << std::setw(8) << qs[i]
+                          << std::setprecision(4)
+                          << std::setw(17) << kSpot[i]
+                          << std::setw(11) << spot.hist.quantile(qs[i], spot.mom.n, spot.mom.hi)
+                          << std::setw(12) << sExact
+                          << std::setw(19) << kPay[i]
+                          << std::setw(11) << pay.hist.quantile(qs[i], pay.mom.n, pay.mom.hi)
+                          << std::setw(11) << disc * std::max(sExact - c.K, 0.0) << "\n";
+            }
+
+            double q99 = pay.hist.quantile(0.99, pay.mom.n, pay.mom.hi);
+            double es99 = pay.hist.tail_mean(0.01, pay.mom.n, true);
+            double pZero = pay.hist.count[0] / pay.mom.n;
+            std::cout << std::fixed << std::setprecision(6)
+                      << "P(payoff=0)= " << pZero
+                      << "   upper 1% tail mean= " << es99
+                      << "   lower 50% tail mean= " << pay.hist.tail_mean(0.5, pay.mom.n, false) << "\n"
+                      << "short call at " << price << ": VaR99= " << q99 - price
+                      << "   ES99= " << es99 - price << "\n"
+                      << "sketch memory per stream= " << (pay.bytes() + 1023) / 1024 << " KiB"
+                      << "   kll items= " << pay.kll.items() << " (" << pay.kll.levels.size()
+                      << " levels)\n";
+        }
+
+        std::cout << "paths/s= " << std::scientific << std::setprecision(3) << N / elapsed << "\n";
+        std::cout << std::fixed << std::setprecision(6)
+                  << "value= " << price << " in " << elapsed << " s\n";
+    }
+
+    MPI_Finalize();
+    return 0;
+}
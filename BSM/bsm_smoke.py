@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+#
+# Smoke check of the bsm module built from BSM_python.cxx: imports it,
+# prices a small batch of calls and puts with the closed form and with
+# the mc backend, and fails if any Monte Carlo price is more than 4
+# standard errors away from the closed form.
+#
+# Usage: python3 bsm_smoke.py   (from BSM/, or with BSM/ on PYTHONPATH)
+
+import sys
+
+import numpy as np
+
+import bsm
+
+n = 16
+S0 = np.full(n, 100.0)
+K = np.linspace(80.0, 120.0, n)
+T = np.linspace(0.25, 2.0, n)
+r = np.full(n, 0.06)
+sigma = np.full(n, 0.2)
+q = np.full(n, 0.02)
+is_call = (np.arange(n) % 2 == 0).astype(np.uint8)
+
+exact = bsm.price(S0, K, T, r, sigma, q=q, is_call=is_call)
+mc, se = bsm.price(S0, K, T, r, sigma, q=q, is_call=is_call, num_sims=1 << 16,
+                   backend="mc", seed=1, return_stderr=True)
+
+z = (mc - exact) / se
+worst = int(np.argmax(np.abs(z)))
+print("bsm smoke: %d options, max |z| = %.2f (K=%g T=%g %s)"
+      % (n, abs(z[worst]), K[worst], T[worst], "call" if is_call[worst] else "put"))
+if not np.all(np.isfinite(mc)) or np.any(np.abs(z) > 4.0):
+    print("bsm smoke: FAILED")
+    sys.exit(1)
@@ -9,4 +9,27 @@ armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funro
 armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_SVE.cxx -o BSM_SVE
 armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_assembly.cxx -o BSM_assembly
 armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_final.cxx -o BSM_final
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_pde.cxx -o BSM_pde
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_impliedvol.cxx -o BSM_impliedvol
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_server.cxx -o BSM_server
+g++ -O2 -pthread BSM_loadgen.cxx -o BSM_loadgen
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_portfolio.cxx -o BSM_portfolio
+armclang++ -std=c++20 -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -pthread -larmpl -lamath -lm BSM_async.cxx -o BSM_async
+if python3 -c 'import pybind11' 2> /dev/null; then
+    armclang++ -g3 -O3 -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -fvectorize -shared -fPIC $(python3 -m pybind11 --includes) BSM_python.cxx -o bsm$(python3-config --extension-suffix) -larmpl -lamath -lm && python3 bsm_smoke.py
+else
+    echo "pybind11 not found: skipping the bsm Python module"
+fi
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_mlmc.cxx -o BSM_mlmc
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_importance.cxx -o BSM_importance
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_stratified.cxx -o BSM_stratified
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_aad.cxx -o BSM_aad
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_scenario.cxx -o BSM_scenario
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_localvol.cxx -o BSM_localvol
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_sketch.cxx -o BSM_sketch
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_sorted.cxx -o BSM_sorted
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_barrier.cxx -o BSM_barrier
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_lattice.cxx -o BSM_lattice
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_calibration.cxx -o BSM_calibration
+armclang++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -fvectorize -larmpl -lamath -lm BSM_accuracy.cxx -o BSM_accuracy
 g++ -g3 -Ofast -fopenmp -march=armv9-a+simd+fp16 -mcpu=neoverse-v2 -funroll-loops -ffast-math -ftree-vectorize -frename-registers -I$ARMPL_DIR/include -L$ARMPL_DIR/lib -larmpl_mp -L$ARMPL_DIR/lib -lamath  BSM_final_gcc.cxx -o BSM_final_gcc
@@ -0,0 +1,183 @@
+#!/bin/bash
+#
+# Strong / weak scaling study that runs on any Linux machine (no SLURM).
+#
+# Sweeps OpenMP thread counts on BSM_final and, when mpirun is available,
+# MPI rank counts on BSM_open_mpi. Every configuration is repeated and the
+# per-run times are reduced to median / mean / 95% confidence interval.
+#
+#   strong: the total work (num_sims x num_runs) is fixed.
+#   weak:   the work grows with the worker count (num_runs for threads,
+#           num_sims for ranks, which is what each program splits).
+#
+# Outputs <out>_runs.csv (one line per run), <out>.csv and <out>.json
+# (one record per configuration) with speedup, parallel efficiency and
+# paths/s per core. Speedup and efficiency are relative to the smallest
+# worker count of the sweep; for weak scaling the speedup is the scaled
+# speedup p * T(1) / T(p).
+#
+# Usage: ./scaling_study.sh [--threads "1 2 4 8"] [--ranks "1 2 4"]
+#                           [--strong "NSIMS NRUNS"] [--weak "NSIMS NRUNS"]
+#                           [--repeats 5] [--mode strong|weak|both]
+#                           [--out scaling] [--build] [--no-mpi]
+#                           [--args "extra BSM_final options"]
+
+set -e
+cd "$(dirname "$0")"
+
+NPROC=$(nproc)
+THREADS=""
+RANKS=""
+STRONG="2000 100000"
+WEAK="1000 10000"
+REPEATS=5
+MODE=both
+OUT=scaling
+BUILD=0
+USE_MPI=1
+EXTRA="--no-tune"
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --threads) THREADS="$2"; shift 2 ;;
+        --ranks)   RANKS="$2"; shift 2 ;;
+        --strong)  STRONG="$2"; shift 2 ;;
+        --weak)    WEAK="$2"; shift 2 ;;
+        --repeats) REPEATS="$2"; shift 2 ;;
+        --mode)    MODE="$2"; shift 2 ;;
+        --out)     OUT="$2"; shift 2 ;;
+        --build)   BUILD=1; shift ;;
+        --no-mpi)  USE_MPI=0; shift ;;
+        --args)    EXTRA="$2"; shift 2 ;;
+        -h|--help) sed -n '2,24p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+        *) echo "unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+# Default sweep: powers of two up to the core count, plus the core count.
+if [ -z "$THREADS" ]; then
+    p=1
+    while [ $p -lt $NPROC ]; do THREADS="$THREADS $p"; p=$((p * 2)); done
+    THREADS="$THREADS $NPROC"
+fi
+[ -z "$RANKS" ] && RANKS="$THREADS"
+
+if ! command -v mpirun > /dev/null; then USE_MPI=0; fi
+MPIRUN="mpirun --oversubscribe"
+[ "$(id -u)" = 0 ] && MPIRUN="$MPIRUN --allow-run-as-root"
+
+# Portable build: compile.sh targets ACfL on Graviton, so --build uses the
+# local compiler and empty ArmPL headers when ArmPL is not installed
+# (BSM_final only includes them).
+if [ $BUILD = 1 ]; then
+    CXX=${CXX:-g++}
+    INC=""
+    if ! echo '#include <armpl.h>' | $CXX -x c++ -E - > /dev/null 2>&1; then
+        INC=$(mktemp -d)
+        touch "$INC/armpl.h" "$INC/amath.h"
+        INC="-I$INC"
+    fi
+    echo "building BSM/BSM_final with $CXX"
+    $CXX -O3 -fopenmp -march=native -ffast-math $INC BSM/BSM_final.cxx -o BSM/BSM_final
+    if [ $USE_MPI = 1 ] && command -v mpicxx > /dev/null; then
+        echo "building BSM/BSM_open_mpi with mpicxx"
+        mpicxx -O3 -fopenmp -march=native -ffast-math BSM/BSM_open_mpi.cxx -o BSM/BSM_open_mpi
+    fi
+fi
+
+if [ ! -x BSM/BSM_final ]; then
+    echo "BSM/BSM_final not found: run ./compile.sh or pass --build" >&2
+    exit 1
+fi
+[ -x BSM/BSM_open_mpi ] || USE_MPI=0
+
+# Runs one configuration and prints its wall time (the "in <t> s" field).
+run_once() {
+    local backend=$1 p=$2 nsims=$3 nruns=$4 out
+    if [ $backend = omp ]; then
+        out=$(OMP_NUM_THREADS=$p BSM/BSM_final $nsims $nruns $EXTRA 2> /dev/null)
+    else
+        out=$(OMP_NUM_THREADS=1 $MPIRUN -n $p BSM/BSM_open_mpi $nsims $nruns 2> /dev/null)
+    fi
+    echo "$out" | sed -n 's/.*value= *[-0-9.e+]* in \([0-9.e+]*\).*/\1/p' | tail -n 1
+}
+
+RUNS_CSV=${OUT}_runs.csv
+echo "mode,backend,workers,num_sims,num_runs,repeat,seconds" > $RUNS_CSV
+
+echo "cores= $NPROC   threads= [$THREADS ]   ranks= [$RANKS ]   repeats= $REPEATS   mpi= $USE_MPI"
+
+# One discarded warm-up run (page cache, CPU frequency ramp).
+run_once omp 1 $(echo $STRONG | awk '{print int($1 / 10) + 1, 1}') > /dev/null
+
+sweep() {
+    local mode=$1 backend=$2 counts=$3 base_sims=$4 base_runs=$5
+    for p in $counts; do
+        local nsims=$base_sims nruns=$base_runs
+        if [ $mode = weak ]; then
+            if [ $backend = omp ]; then nruns=$((base_runs * p)); else nsims=$((base_sims * p)); fi
+        fi
+        for rep in $(seq 1 $REPEATS); do
+            t=$(run_once $backend $p $nsims $nruns)
+            if [ -z "$t" ]; then
+                echo "  $mode $backend p=$p: run failed" >&2
+                continue
+            fi
+            echo "$mode,$backend,$p,$nsims,$nruns,$rep,$t" >> $RUNS_CSV
+            printf "  %-6s %-4s p=%-4s repeat %d/%d: %s s\n" $mode $backend $p $rep $REPEATS $t
+        done
+    done
+}
+
+for mode in strong weak; do
+    [ $MODE != both ] && [ $MODE != $mode ] && continue
+    if [ $mode = strong ]; then set -- $STRONG; else set -- $WEAK; fi
+    sweep $mode omp "$THREADS" $1 $2
+    [ $USE_MPI = 1 ] && sweep $mode mpi "$RANKS" $1 $2
+done
+
+# Reduce the runs: median, mean and 95% CI (Student t) per configuration,
+# then speedup / efficiency against the first worker count of each sweep.
+sort -t, -k1,1 -k2,2 -k3,3n -k7,7g <(tail -n +2 $RUNS_CSV) | awk -F, -v csv=${OUT}.csv -v json=${OUT}.json \
+    -v host="$(hostname)" -v cores=$NPROC -v date="$(date -u +%Y-%m-%dT%H:%M:%SZ)" '
+function tq(df) {  # two-sided 95% Student t quantile
+    split("12.706 4.303 3.182 2.776 2.571 2.447 2.365 2.306 2.262 2.228", t, " ")
+    return df < 1 ? 0 : (df <= 10 ? t[df] : (df <= 30 ? 2.042 : 1.96))
+}
+function flush(   n, med, mean, sd, ci, paths, key, speedup, eff, pps) {
+    n = cnt
+    if (n == 0) return
+    med = (n % 2) ? v[(n + 1) / 2] : 0.5 * (v[n / 2] + v[n / 2 + 1])
+    mean = s / n
+    sd = (n > 1) ? sqrt((ss - n * mean * mean) / (n - 1)) : 0
+    if (sd != sd || sd < 0) sd = 0
+    ci = tq(n - 1) * sd / sqrt(n)
+    paths = cur_sims * cur_runs
+    key = cur_mode "," cur_backend
+    if (!(key in base_t)) { base_t[key] = med; base_p[key] = cur_p }
+    if (cur_mode == "strong") speedup = base_t[key] / med * 1.0
+    else speedup = (cur_p / base_p[key]) * base_t[key] / med
+    eff = speedup * base_p[key] / cur_p
+    pps = paths / med / cur_p
+    printf "%s,%s,%d,%s,%s,%d,%.6f,%.6f,%.6f,%.6f,%.4f,%.4f,%.6e\n", cur_mode, cur_backend, cur_p, cur_sims, cur_runs, n, med, mean, v[1], ci, speedup, eff, pps > csv
+    printf "%s    {\"mode\": \"%s\", \"backend\": \"%s\", \"workers\": %d, \"num_sims\": %s, \"num_runs\": %s, \"repeats\": %d, \"median_s\": %.6f, \"mean_s\": %.6f, \"min_s\": %.6f, \"ci95_s\": %.6f, \"speedup\": %.4f, \"efficiency\": %.4f, \"paths_per_s_per_core\": %.6e}", (nrec++ ? ",\n" : ""), cur_mode, cur_backend, cur_p, cur_sims, cur_runs, n, med, mean, v[1], ci, speedup, eff, pps > json
+    printf "%-6s %-4s %5d  %10.4f s  +- %8.4f  speedup %7.2f  efficiency %6.1f%%  %10.3e paths/s/core\n", cur_mode, cur_backend, cur_p, med, ci, speedup, 100 * eff, pps
+    cnt = 0; s = 0; ss = 0
+}
+BEGIN {
+    print "mode,backend,workers,num_sims,num_runs,repeats,median_s,mean_s,min_s,ci95_s,speedup,efficiency,paths_per_s_per_core" > csv
+    printf "{\n  \"host\": \"%s\",\n  \"cores\": %d,\n  \"date\": \"%s\",\n  \"configurations\": [\n", host, cores, date > json
+    printf "\n%-6s %-4s %5s  %12s  %11s\n", "mode", "", "p", "median", "ci95"
+}
+{
+    id = $1 "," $2 "," $3
+    if (id != cur_id) { flush(); cur_id = id }
+    cur_mode = $1; cur_backend = $2; cur_p = $3; cur_sims = $4; cur_runs = $5
+    v[++cnt] = $7; s += $7; ss += $7 * $7
+}
+END {
+    flush()
+    printf "\n  ]\n}\n" > json
+}'
+
+echo "wrote $RUNS_CSV ${OUT}.csv ${OUT}.json"